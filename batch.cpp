@@ -0,0 +1,135 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batch.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+using std::endl;
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include "options.hpp"
+#include "process.hpp"
+#include "surface.hpp"
+#include "douglas_peucker.hpp"
+#include "log.hpp"
+
+BatchProcessor::BatchProcessor( const string& manifest, uint threads )
+	: threads( threads ? threads : 1 ), next_job(0)
+{
+	std::ifstream in( manifest.c_str() );
+	if( !in.good() )
+		throw std::runtime_error( "Cannot read batch manifest \"" + manifest + "\"" );
+
+	string line;
+	while( std::getline( in, line ) ) {
+		std::istringstream tokens( line );
+		job j;
+		if( !( tokens >> j.dir ) || j.dir[0] == '#' )
+			continue;
+
+		string arg;
+		while( tokens >> arg )
+			j.args.push_back( arg );
+		j.failed = false;
+		jobs.push_back( j );
+	}
+}
+
+uint
+BatchProcessor::run()
+{
+	// the debug images would all end up in the current directory
+	Surface::set_debug_images( false );
+	// the boards keep the processors busy already
+	if( threads > 1 ) {
+		Surface::set_tracing_threads( 1 );
+		Gcode::set_threads( 1 );
+	}
+
+	LOG(LOG_INFO) << "Processing " << jobs.size() << " job(s) on " << threads << " thread(s)" << endl;
+
+	boost::thread_group pool;
+	for( uint i = 0; i < threads; i++ )
+		pool.create_thread( boost::bind( &BatchProcessor::worker, this ) );
+	pool.join_all();
+
+	uint failed = 0;
+	BOOST_FOREACH( job& j, jobs ) {
+		if( j.failed ) {
+			LOG(LOG_ERROR) << "Failed: " << j.dir << endl;
+			failed++;
+		}
+	}
+	LOG(LOG_INFO) << jobs.size() - failed << " of " << jobs.size() << " job(s) succeeded" << endl;
+
+	return failed;
+}
+
+void
+BatchProcessor::worker()
+{
+	while( true ) {
+		uint index;
+		{
+			boost::mutex::scoped_lock lock( mutex );
+			if( next_job >= jobs.size() )
+				return;
+			index = next_job++;
+		}
+		process_job( jobs[index], index );
+	}
+}
+
+void
+BatchProcessor::process_job( job& j, uint index )
+{
+	// collect the job's output so it doesn't interleave with other jobs
+	std::stringstream log;
+
+	Log::set_stream( &log );
+
+	try {
+		po::variables_map vm;
+		options::parse_job( j.dir, j.args, vm );
+		options::check_parameters( vm );
+		process_board( vm );
+	} catch( parameter_error& pe ) {
+		LOG(LOG_ERROR) << pe.what();
+		j.failed = true;
+	} catch( std::exception& e ) {
+		LOG(LOG_ERROR) << "Error: " << e.what() << endl;
+		j.failed = true;
+	} catch( ... ) {
+		LOG(LOG_ERROR) << "Error: unknown failure" << endl;
+		j.failed = true;
+	}
+
+	Log::set_stream( NULL );
+
+	boost::mutex::scoped_lock lock( mutex );
+	LOG(LOG_INFO) << "=== Job " << index + 1 << "/" << jobs.size() << ": " << j.dir
+		      << ( j.failed ? " FAILED" : "" ) << endl
+		      << log.str() << endl;
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+//! Processes many boards listed in a manifest file within a single process.
+/*! Every non-empty line of the manifest names a job directory, optionally
+ *  followed by whitespace separated options for that job (--name=value).
+ *  Lines starting with '#' are comments. Each job reads the millproject file
+ *  of its directory; input and output files are relative to that directory,
+ *  and the batch's own options serve as defaults.
+ *
+ *  The jobs are distributed over a pool of worker threads. A failing job is
+ *  reported but doesn't affect the others.
+ */
+class BatchProcessor : boost::noncopyable
+{
+public:
+	BatchProcessor( const string& manifest, uint threads );
+
+	//! returns the number of failed jobs
+	uint run();
+
+private:
+	struct job {
+		string dir;
+		vector<string> args;
+		bool failed;
+	};
+
+	void worker();
+	void process_job( job& j, uint index );
+
+	vector<job> jobs;
+	uint threads;
+	uint next_job;
+	boost::mutex mutex;
+};
+
+#endif // BATCH_H
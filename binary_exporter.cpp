@@ -0,0 +1,183 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "binary_exporter.hpp"
+#include "toolpath_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+
+using namespace toolpath_file;
+
+BinaryExporter::BinaryExporter( shared_ptr<Board> board ) : Exporter(board), board(board)
+{
+}
+
+void
+BinaryExporter::add_drill( const map<int,drillbit>& bits, const map<int,icoords>& holes,
+			   bool mirrored, ivalue_t axis )
+{
+	for( map<int,icoords>::const_iterator it = holes.begin(); it != holes.end(); it++ ) {
+		map<int,drillbit>::const_iterator bit = bits.find( it->first );
+		if( bit == bits.end() )
+			continue;
+
+		drills.push_back( drill_table() );
+		drill_table& table = drills.back();
+		table.tool = it->first;
+		table.diameter = bit->second.unit == "mm" ? bit->second.diameter / 25.4 : bit->second.diameter;
+
+		BOOST_FOREACH( const icoordpair& hole, it->second ) {
+			table.xs.push_back( mirrored ? axis - hole.first : hole.first );
+			table.ys.push_back( hole.second );
+		}
+	}
+}
+
+template <typename T>
+static void write_array( std::ostream& out, const T* values, size_t count )
+{
+	if( count )
+		out.write( reinterpret_cast<const char*>( values ), count * sizeof(T) );
+}
+
+/* The records and arrays are written in the order of the offsets, which are
+ * all calculated before: the header, the layer records, the contours and
+ * points of every layer, the drill records and their holes.
+ */
+void
+BinaryExporter::export_all( boost::program_options::variables_map& options )
+{
+	string of_name = options["binary"].as<string>();
+
+	// the records are written as they are in memory
+	if( !little_endian() )
+		throw std::runtime_error( "Binary toolpath files can only be written on little-endian machines." );
+
+	vector<string> layers = board->list_layers();
+
+	file_header header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, magic, sizeof(magic) );
+	header.version = version;
+	header.layer_count = layers.size();
+	header.drill_count = drills.size();
+	header.min_x = board->get_min_x();
+	header.min_y = board->get_min_y();
+	header.max_x = board->get_max_x();
+	header.max_y = board->get_max_y();
+	header.layers_offset = sizeof(file_header);
+
+	uint64_t offset = header.layers_offset + layers.size() * sizeof(layer_record);
+
+	vector<layer_record> layer_records( layers.size() );
+	for( size_t i = 0; i < layers.size(); i++ ) {
+		const ToolpathSet& toolpaths = board->get_toolpath( layers[i] );
+		shared_ptr<RoutingMill> mill = board->get_manufacturer( layers[i] );
+		shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>( mill );
+		layer_record& record = layer_records[i];
+
+		memset( &record, 0, sizeof(record) );
+		strncpy( record.name, layers[i].c_str(), sizeof(record.name) );
+		record.tool_diameter = mill->tool_diameter;
+		record.feed = mill->feed;
+		record.zsafe = mill->zsafe;
+		record.zwork = mill->zwork;
+		record.zchange = mill->zchange;
+		record.stepsize = cutter && cutter->do_steps ? cutter->stepsize : 0;
+		record.speed = mill->speed;
+		record.flags = toolpaths.has_z() ? LAYER_HAS_Z : 0;
+		record.contour_count = toolpaths.size();
+		record.point_count = toolpaths.point_count();
+
+		record.contours_offset = offset;
+		offset += record.contour_count * sizeof(contour_record);
+		record.x_offset = offset;
+		offset += record.point_count * sizeof(double);
+		record.y_offset = offset;
+		offset += record.point_count * sizeof(double);
+		if( toolpaths.has_z() ) {
+			record.z_offset = offset;
+			offset += record.point_count * sizeof(double);
+		}
+	}
+
+	header.drills_offset = offset;
+	offset += drills.size() * sizeof(drill_record);
+
+	vector<drill_record> drill_records( drills.size() );
+	for( size_t i = 0; i < drills.size(); i++ ) {
+		drill_record& record = drill_records[i];
+		memset( &record, 0, sizeof(record) );
+		record.tool = drills[i].tool;
+		record.diameter = drills[i].diameter;
+		record.hole_count = drills[i].xs.size();
+		record.x_offset = offset;
+		offset += record.hole_count * sizeof(double);
+		record.y_offset = offset;
+		offset += record.hole_count * sizeof(double);
+	}
+
+	std::ofstream out( of_name.c_str(), std::ios::binary | std::ios::trunc );
+	write_array( out, &header, 1 );
+	write_array( out, layer_records.empty() ? NULL : &layer_records[0], layer_records.size() );
+
+	vector<contour_record> contours;
+	vector<double> coordinates;
+	for( size_t i = 0; i < layers.size(); i++ ) {
+		const ToolpathSet& toolpaths = board->get_toolpath( layers[i] );
+
+		contours.resize( toolpaths.size() );
+		for( size_t c = 0; c < toolpaths.size(); c++ ) {
+			contours[c].begin = toolpaths.contour_begin(c);
+			contours[c].size = toolpaths.contour_size(c);
+			contours[c].pass = toolpaths.get_pass(c);
+			contours[c].closed = toolpaths.is_closed(c);
+			contours[c].depth = toolpaths.get_depth(c);
+		}
+		write_array( out, contours.empty() ? NULL : &contours[0], contours.size() );
+
+		// the points are converted from the toolpaths' own number format
+		coordinates.resize( toolpaths.point_count() );
+		for( size_t p = 0; p < toolpaths.point_count(); p++ )
+			coordinates[p] = toolpaths.x(p);
+		write_array( out, coordinates.empty() ? NULL : &coordinates[0], coordinates.size() );
+		for( size_t p = 0; p < toolpaths.point_count(); p++ )
+			coordinates[p] = toolpaths.y(p);
+		write_array( out, coordinates.empty() ? NULL : &coordinates[0], coordinates.size() );
+		if( toolpaths.has_z() ) {
+			for( size_t p = 0; p < toolpaths.point_count(); p++ )
+				coordinates[p] = toolpaths.z(p);
+			write_array( out, coordinates.empty() ? NULL : &coordinates[0], coordinates.size() );
+		}
+	}
+
+	write_array( out, drill_records.empty() ? NULL : &drill_records[0], drill_records.size() );
+	BOOST_FOREACH( const drill_table& table, drills ) {
+		write_array( out, table.xs.empty() ? NULL : &table.xs[0], table.xs.size() );
+		write_array( out, table.ys.empty() ? NULL : &table.ys[0], table.ys.size() );
+	}
+
+	out.close();
+	if( !out )
+		throw std::runtime_error( "Error writing " + of_name );
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINARY_EXPORTER_H
+#define BINARY_EXPORTER_H
+
+#include <map>
+using std::map;
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include "coord.hpp"
+#include "drill.hpp"
+#include "exporter.hpp"
+
+//! Writes the toolpaths of all layers and the drill holes into one binary file.
+/*! The format is described in toolpath_file.hpp, which also has a reader
+ *  for it. The layers come from the board, the drill holes have to be added
+ *  before export_all writes the file named by --binary.
+ */
+class BinaryExporter : public Exporter
+{
+public:
+	BinaryExporter( shared_ptr<Board> board );
+
+	//! the holes at the positions of the drill G-code, mirrored at axis if mirrored
+	void add_drill( const map<int,drillbit>& bits, const map<int,icoords>& holes,
+			bool mirrored, ivalue_t axis );
+
+	void export_all( boost::program_options::variables_map& options );
+
+private:
+	struct drill_table {
+		int tool;
+		double diameter;
+		vector<double> xs, ys;
+	};
+
+	shared_ptr<Board> board;
+	vector<drill_table> drills;
+};
+
+#endif // BINARY_EXPORTER_H
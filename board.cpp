@@ -20,6 +20,11 @@
 
 #include "board.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#include "log.hpp"
+
 typedef pair<string, shared_ptr<Layer> > layer_t;
 
 Board::Board( int _dpi, bool _fill_outline, double _outline_width)
@@ -28,18 +33,33 @@ Board::Board( int _dpi, bool _fill_outline, double _outline_width)
 	dpi = _dpi;
 	fill_outline = _fill_outline;
 	outline_width = _outline_width;
+	auto_dpi = false;
+	memory_budget = 0;
+	dimensions_calculated = false;
+	marching_squares = false;
+}
+
+/* Let the board choose its resolution in createLayers instead of using the
+ * one passed to the constructor. memory_budget is the maximum number of bytes
+ * all surfaces together may allocate.
+ */
+void
+Board::set_auto_dpi( double memory_budget )
+{
+	auto_dpi = true;
+	this->memory_budget = memory_budget;
 }
 
 double
 Board::get_width()
 {
-	return layers.begin()->second->surface->get_width_in();
+	return max_x - min_x;
 }
 
 double
 Board::get_height()
 {
-	return layers.begin()->second->surface->get_height_in();
+	return max_y - min_y;
 }
 
 uint
@@ -53,10 +73,14 @@ Board::prepareLayer( string layername, shared_ptr<LayerImporter> importer, share
 {
         // see comment for prep_t in board.hpp
         prepared_layers.insert( std::make_pair( layername, make_tuple(importer, manufacturer, mirror, mirror_absolute) ) );
+	dimensions_calculated = false;
 }
 
+/* Calculates the board's extents from all prepared layers and, if requested,
+ * the resolution. Nothing gets rendered yet.
+ */
 void
-Board::createLayers()
+Board::calculateDimensions()
 {
 	if( !prepared_layers.size() )
 		throw std::logic_error("No layers prepared.");
@@ -98,25 +122,171 @@ Board::createLayers()
                 max_y += margin;
         }
 
+	if( auto_dpi )
+		planResolution();
+
+	dimensions_calculated = true;
+}
+
+/* Pick the lowest resolution at which the smallest aperture of any layer
+ * is still a few pixels wide, so that neither the traces nor the
+ * clearances between them (which are usually of the same order) break
+ * up or merge while rendering. The result is capped by the memory budget,
+ * as the surfaces grow quadratically with the resolution.
+ */
+void
+Board::planResolution()
+{
+	// pixels the smallest feature has to span to survive rendering and growing
+	const double pixels_per_feature = 4;
+	// resolutions are rounded to multiples of this
+	const uint dpi_step = 50;
+	const uint min_dpi = 100;
+
+	ivalue_t min_feature = 0;
+	for( map< string, prep_t >::iterator it = prepared_layers.begin(); it != prepared_layers.end(); it++ ) {
+		ivalue_t feature = it->second.get<0>()->get_min_feature_size();
+		if( feature > 0 && ( min_feature == 0 || feature < min_feature ) )
+			min_feature = feature;
+	}
+
+	uint wanted_dpi = dpi;
+	if( min_feature > 0 )
+		wanted_dpi = uint( ceil( pixels_per_feature / min_feature / dpi_step ) ) * dpi_step;
+	wanted_dpi = std::max( wanted_dpi, min_dpi );
+
+	// find the highest resolution that fits into the memory budget
+	const size_t layer_count = prepared_layers.size();
+	uint budget_dpi = wanted_dpi;
+	while( budget_dpi > min_dpi &&
+	       layer_count * Surface::get_memory_footprint( budget_dpi, max_x - min_x, max_y - min_y ) > memory_budget )
+		budget_dpi -= dpi_step;
+
+	dpi = std::min( wanted_dpi, budget_dpi );
+	size_t footprint = layer_count * Surface::get_memory_footprint( dpi, max_x - min_x, max_y - min_y );
+
+	LOG(LOG_INFO) << "Automatic resolution: smallest feature " << min_feature << "in needs "
+	     << wanted_dpi << " dpi, using " << dpi << " dpi" << endl;
+	LOG(LOG_INFO) << "Predicted surface memory: " << footprint / ( 1024 * 1024 ) << " MiB for "
+	     << layer_count << " layer(s)" << endl;
+
+	if( dpi < wanted_dpi )
+		LOG(LOG_WARNING) << "Warning: the memory budget doesn't allow resolving the smallest "
+				 << "features, isolation between fine-pitch pads may break." << endl;
+}
+
+/* Describes everything the toolpaths of a layer depend on, for looking them
+ * up in the toolpath cache and for recognizing unchanged layers.
+ */
+string
+Board::get_layer_key( string layername )
+{
+	prep_t& prep = prepared_layers.at(layername);
+	shared_ptr<RoutingMill> mill = prep.get<1>();
+
+	std::ostringstream key;
+	key.precision(17);
+	key << "input " << prep.get<0>()->get_fingerprint() << "\n"
+	    << "dpi " << dpi << "\n"
+	    << "bounds " << min_x << " " << max_x << " " << min_y << " " << max_y << "\n"
+	    << "mirror " << prep.get<2>() << " " << prep.get<3>() << "\n"
+	    << "tool " << mill->tool_diameter << "\n"
+	    << "engine " << ( polygon_layers.count(layername) ? "polygon" : "raster" ) << "\n"
+	    << "contour " << ( marching_squares ? "marching-squares" : "pixels" ) << "\n";
+
+	Isolator* iso = dynamic_cast<Isolator*>( mill.get() );
+	if( iso )
+		key << "extra-passes " << iso->extra_passes << "\n";
+
+	// all layers get masked with (or are) the outline
+	map< string, prep_t >::iterator outline = prepared_layers.find("outline");
+	if( outline != prepared_layers.end() ) {
+		key << "outline " << outline->second.get<0>()->get_fingerprint() << " "
+		    << fill_outline << " " << outline_width << "\n";
+	}
+
+	return key.str();
+}
+
+void
+Board::createLayers()
+{
+	if( !dimensions_calculated )
+		calculateDimensions();
+
+	// layers whose toolpaths are cached don't need to be rendered, skipped
+	// layers aren't created at all, and neither are the layers isolated by
+	// the polygon engine. the outline is an exception if it has to mask
+	// other layers.
+	map< string, shared_ptr<ToolpathSet> > cached_toolpaths;
+	map< string, shared_ptr<PolygonEngine> > engines;
+	bool outline_needed = false;
+
+        for( map<string, prep_t>::iterator it = prepared_layers.begin(); it != prepared_layers.end(); it++ ) {
+		if( skipped_layers.count(it->first) )
+			continue;
+
+		shared_ptr<ToolpathSet> toolpath( new ToolpathSet() );
+		if( toolpath_cache && toolpath_cache->load( get_layer_key(it->first), *toolpath ) ) {
+			cached_toolpaths[it->first] = toolpath;
+			LOG(LOG_INFO) << "Using cached toolpaths for " << it->first << endl;
+			continue;
+		}
+
+		if( polygon_layers.count(it->first) ) {
+			shared_ptr<PolygonEngine> engine = createPolygonEngine(it->first);
+			if( engine ) {
+				engines[it->first] = engine;
+				continue;
+			}
+		}
+
+		if( it->first != "outline" )
+			outline_needed = true;
+	}
+
         // board size calculated. create layers
         for( map<string, prep_t>::iterator it = prepared_layers.begin(); it != prepared_layers.end(); it++ ) {
+		bool cached = cached_toolpaths.count(it->first);
+		bool polygon = engines.count(it->first);
+		bool mask = it->first == "outline" && outline_needed;
+
+		if( skipped_layers.count(it->first) && !mask )
+			continue;
+
 		// prepare the surface
-                shared_ptr<Surface> surface( new Surface(dpi, min_x, max_x, min_y, max_y) );
-                shared_ptr<LayerImporter> importer = it->second.get<0>();
-                surface->render(importer);
+		shared_ptr<Surface> surface;
+		if( ( !cached && !polygon ) || mask ) {
+			surface.reset( new Surface(dpi, min_x, max_x, min_y, max_y) );
+			surface->set_marching_squares( marching_squares );
+			shared_ptr<LayerImporter> importer = it->second.get<0>();
+			surface->render(importer);
+		}
 
 		shared_ptr<Layer> layer( new Layer(it->first, surface, it->second.get<1>(), it->second.get<2>(), it->second.get<3>() ) ); // see comment for prep_t in board.hpp
+
+		if( toolpath_cache ) {
+			layer->cache = toolpath_cache;
+			layer->cache_key = get_layer_key(it->first);
+		}
+		if( cached ) {
+			layer->toolpaths.swap( *cached_toolpaths[it->first] );
+			layer->traced = true;
+		}
+		if( polygon )
+			layer->engine = engines[it->first];
                 
 		layers.insert( std::make_pair( layer->get_name(), layer ) );
         }
 
         // DEBUG output
         BOOST_FOREACH( layer_t layer, layers ) {
-                layer.second->surface->save_debug_image(string("original_")+layer.second->get_name());
+		if( layer.second->surface )
+			layer.second->surface->save_debug_image(string("original_")+layer.second->get_name());
         }
 
 	// mask layers with outline
-	if( prepared_layers.find("outline") != prepared_layers.end()) {
+	if( prepared_layers.find("outline") != prepared_layers.end() && layers.at("outline")->surface ) {
 		shared_ptr<Layer> outline_layer = layers.at("outline");
 
 		if(fill_outline) {
@@ -124,7 +294,7 @@ Board::createLayers()
 		}
 
 		for (map<string, shared_ptr<Layer> >::iterator it = layers.begin(); it != layers.end(); it++ ) {
-			if(it->second != outline_layer) {
+			if(it->second != outline_layer && it->second->surface) {
 				it->second->add_mask(outline_layer);
 				it->second->surface->save_debug_image("masked");
 			}
@@ -132,11 +302,39 @@ Board::createLayers()
 	}
 }
 
-vector< shared_ptr<icoords> >
-Board::get_toolpath( string layername )
+/* Sets up the polygon engine for a layer, masked by the outline if there is
+ * one. Returns an empty pointer if the layer or the outline can't be
+ * converted to polygons; such layers get rendered instead.
+ */
+shared_ptr<PolygonEngine>
+Board::createPolygonEngine( string layername )
 {
-	vector< shared_ptr<icoords> > toolpath;
+	vector<icoords> polygons;
+	if( !prepared_layers.at(layername).get<0>()->get_polygons(polygons) ) {
+		LOG(LOG_WARNING) << "Warning: the " << layername << " layer contains features the polygon engine "
+				 << "can't handle, using the photoplot instead." << endl;
+		return shared_ptr<PolygonEngine>();
+	}
 
+	shared_ptr<PolygonEngine> engine( new PolygonEngine( polygons, min_x, max_x ) );
+
+	map< string, prep_t >::iterator outline = prepared_layers.find("outline");
+	if( outline != prepared_layers.end() ) {
+		vector<icoords> outline_polygons;
+		if( !outline->second.get<0>()->get_polygons(outline_polygons) ) {
+			LOG(LOG_WARNING) << "Warning: the outline contains features the polygon engine "
+					 << "can't handle, using the photoplot for the " << layername << " layer." << endl;
+			return shared_ptr<PolygonEngine>();
+		}
+		engine->set_mask( outline_polygons, fill_outline ? outline_width / 2 : 0 );
+	}
+
+	return engine;
+}
+
+const ToolpathSet&
+Board::get_toolpath( string layername )
+{
 	try {
 		return layers[layername]->get_toolpaths();
 	} catch ( std::logic_error& e ) {
@@ -153,12 +351,37 @@ Board::list_layers()
         vector<string> layerlist;
 
         BOOST_FOREACH( layer_t layer, layers ) {
-                layerlist.push_back( layer.first );
+		if( !skipped_layers.count(layer.first) )
+			layerlist.push_back( layer.first );
         }
 
         return layerlist;
 }
 
+vector< string >
+Board::list_prepared_layers()
+{
+	vector<string> layerlist;
+
+	for( map< string, prep_t >::iterator it = prepared_layers.begin(); it != prepared_layers.end(); it++ ) {
+		layerlist.push_back( it->first );
+	}
+
+	return layerlist;
+}
+
+shared_ptr<LayerImporter>
+Board::get_importer( string layername )
+{
+	return prepared_layers.at(layername).get<0>();
+}
+
+shared_ptr<RoutingMill>
+Board::get_manufacturer( string layername )
+{
+	return prepared_layers.at(layername).get<1>();
+}
+
 shared_ptr<Layer>
 Board::get_layer( string layername )
 {
@@ -34,6 +34,7 @@ using std::endl;
 using std::map;
 #include <vector>
 using std::vector;
+#include <set>
 using std::pair;
 
 #include <boost/foreach.hpp>
@@ -47,6 +48,7 @@ using boost::tuple;
 #include "layer.hpp"
 
 #include "mill.hpp"
+#include "toolpath_cache.hpp"
 
 //! Represents a printed circuit board.
 /*! This class calculates the required minimum board size
@@ -60,6 +62,11 @@ public:
 
 	void prepareLayer( string layername, shared_ptr<LayerImporter> importer, shared_ptr<RoutingMill> manufacturer, bool topside, bool mirror_absolute );
 	void set_margins( double margins ) { margin = margins; };
+	void set_auto_dpi( double memory_budget );
+	void set_toolpath_cache( shared_ptr<ToolpathCache> cache ) { toolpath_cache = cache; };
+	void skip_layer( string layername ) { skipped_layers.insert(layername); };
+	void use_polygon_engine( string layername ) { polygon_layers.insert(layername); };
+	void set_marching_squares( bool enabled ) { marching_squares = enabled; };
 
 	ivalue_t get_width();
 	ivalue_t get_height();
@@ -71,17 +78,31 @@ public:
 
 	vector< string > list_layers();
 	shared_ptr<Layer> get_layer( string layername );
-	vector< shared_ptr<icoords> > get_toolpath( string layername );
+	const ToolpathSet& get_toolpath( string layername );
 
 	void createLayers();	// should be private
+	void calculateDimensions();	// done by createLayers; to be used without rendering
+
+	vector< string > list_prepared_layers();
+	shared_ptr<LayerImporter> get_importer( string layername );
+	shared_ptr<RoutingMill> get_manufacturer( string layername );
+	string get_layer_key( string layername );	// needs calculateDimensions
 
 	uint get_dpi();
 
 private:
+	void planResolution();
+	shared_ptr<PolygonEngine> createPolygonEngine( string layername );
+
 	ivalue_t margin;
 	uint dpi;
+	bool auto_dpi;
+	double memory_budget;
+	bool dimensions_calculated;
+	bool marching_squares;
 	bool fill_outline;
 	double outline_width;
+	shared_ptr<ToolpathCache> toolpath_cache;
 	ivalue_t min_x;
 	ivalue_t max_x;
 	ivalue_t min_y;
@@ -99,6 +120,8 @@ private:
 	typedef tuple< shared_ptr<LayerImporter>, shared_ptr<RoutingMill>, bool, bool > prep_t;
 	map< string, prep_t > prepared_layers;
 	map< string, shared_ptr<Layer> >    layers;
+	std::set< string > skipped_layers;	// prepared, but not to be exported
+	std::set< string > polygon_layers;	// isolated by the PolygonEngine if possible
 };
 
 #endif // BOARD_H
@@ -0,0 +1,104 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chaincode.hpp"
+
+#include <boost/foreach.hpp>
+
+const int ChainCode::offset[8][2] = {{1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1}};
+
+// the direction of a step by dx, dy (each -1, 0 or 1), indexed [dy+1][dx+1]
+static const int direction_of[3][3] =
+{
+	{ 5, 6, 7 },
+	{ 4, -1, 0 },
+	{ 3, 2, 1 }
+};
+
+ChainCode::ChainCode( int x, int y )
+	: start_x(x), start_y(y), end_x(x), end_y(y), steps(0)
+{
+}
+
+ChainCode::ChainCode( const coords& pixels )
+	: start_x(0), start_y(0), end_x(0), end_y(0), steps(0)
+{
+	if( pixels.empty() )
+		return;
+
+	start_x = end_x = pixels.front().first;
+	start_y = end_y = pixels.front().second;
+	packed.reserve( (3 * pixels.size() + 7) / 8 );
+
+	BOOST_FOREACH( const coordpair& pixel, pixels ) {
+		extend_to( pixel.first, pixel.second );
+	}
+}
+
+void ChainCode::push( int d )
+{
+	size_t bit = 3 * steps;
+	if( (bit + 3 + 7) / 8 > packed.size() )
+		packed.push_back(0);
+
+	packed[bit / 8] |= d << (bit % 8);
+	if( bit % 8 > 5 )
+		packed[bit / 8 + 1] |= d >> (8 - bit % 8);
+
+	end_x += offset[d][0];
+	end_y += offset[d][1];
+	steps++;
+}
+
+void ChainCode::extend_to( int x, int y )
+{
+	while( end_x != x || end_y != y ) {
+		int dx = (x > end_x) - (x < end_x);
+		int dy = (y > end_y) - (y < end_y);
+		push( direction_of[dy + 1][dx + 1] );
+	}
+}
+
+void ChainCode::decode_corners( coords& corners ) const
+{
+	int x = start_x;
+	int y = start_y;
+	corners.push_back( coordpair(x, y) );
+
+	for( size_t i = 0; i < steps; i++ ) {
+		int d = direction(i);
+		x += offset[d][0];
+		y += offset[d][1];
+
+		if( i + 1 == steps || direction(i + 1) != d )
+			corners.push_back( coordpair(x, y) );
+	}
+}
+
+void ChainCode::decode( ToolpathSet& toolpath, ivalue_t scale_x, ivalue_t offset_x,
+			ivalue_t scale_y, ivalue_t offset_y ) const
+{
+	coords corners;
+	decode_corners(corners);
+
+	BOOST_FOREACH( const coordpair& corner, corners ) {
+		toolpath.add_point( corner.first * scale_x + offset_x,
+				    corner.second * scale_y + offset_y );
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHAINCODE_H
+#define CHAINCODE_H
+
+#include <stdint.h>
+#include <vector>
+using std::vector;
+
+#include "coord.hpp"
+#include "toolpath.hpp"
+
+//! A path of 8-connected pixels, stored as its start pixel and one 3 bit
+//! direction per step.
+/*! The directions are numbered clockwise from +x, with y pointing down like
+ *  in the surfaces: 0 is (1,0), 1 is (1,1), 2 is (0,1) and so on.
+ *  Coordinates only come into being when the path is decoded.
+ */
+class ChainCode
+{
+public:
+	ChainCode( int x, int y );
+
+	//! encodes a pixel path; steps longer than one pixel are split up
+	ChainCode( const coords& pixels );
+
+	//! appends a step in direction d
+	void push( int d );
+
+	//! appends the steps leading to x, y (diagonally first, then straight)
+	void extend_to( int x, int y );
+
+	//! the direction of step i
+	int direction( size_t i ) const {
+		size_t bit = 3 * i;
+		int value = packed[bit / 8] >> (bit % 8);
+		if( bit % 8 > 5 )
+			value |= packed[bit / 8 + 1] << (8 - bit % 8);
+		return value & 7;
+	};
+
+	size_t size() const { return steps; };
+	int get_start_x() const { return start_x; };
+	int get_start_y() const { return start_y; };
+
+	//! the pixels where the direction changes, including start and end
+	void decode_corners( coords& corners ) const;
+
+	//! adds the corners to the last contour of toolpath, mapped to
+	//! x * scale_x + offset_x, y * scale_y + offset_y
+	void decode( ToolpathSet& toolpath, ivalue_t scale_x, ivalue_t offset_x,
+		     ivalue_t scale_y, ivalue_t offset_y ) const;
+
+	//! x and y offset of each direction
+	static const int offset[8][2];
+
+private:
+	int start_x, start_y;
+	int end_x, end_y;
+	size_t steps;
+	vector<uint8_t> packed;
+};
+
+#endif // CHAINCODE_H
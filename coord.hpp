@@ -14,4 +14,24 @@ typedef double ivalue_t;
 typedef std::pair<ivalue_t, ivalue_t> icoordpair;
 typedef std::vector<icoordpair>   icoords;
 
+// the coordinates of stored toolpaths. configure --enable-fixed-point keeps
+// them as 16.16 fixed point inches, which takes half the memory of doubles
+// and makes comparisons exact; they are turned back into ivalue_t when
+// they are read.
+#ifdef FIXED_POINT_TOOLPATHS
+#include <cmath>
+#include "Fixed.hpp"
+typedef numeric::Fixed<16,16> tvalue_t;
+
+inline tvalue_t to_tvalue( ivalue_t value ) {
+	return tvalue_t::from_base( tvalue_t::base_type( std::floor( value * tvalue_t::one + 0.5 ) ) );
+}
+inline ivalue_t from_tvalue( tvalue_t value ) { return value.to_double(); }
+#else
+typedef ivalue_t tvalue_t;
+
+inline tvalue_t to_tvalue( ivalue_t value ) { return value; }
+inline ivalue_t from_tvalue( tvalue_t value ) { return value; }
+#endif
+
 #endif // COORD_H
@@ -0,0 +1,84 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dependencies.hpp"
+#include "hash.hpp"
+
+#include <fstream>
+#include <sstream>
+
+DependencyManifest::DependencyManifest( const string& filename )
+	: filename(filename)
+{
+	std::ifstream in( filename.c_str() );
+
+	string line;
+	while( std::getline( in, line ) ) {
+		if( line.empty() || line[0] == '#' || line[0] == '\t' )
+			continue;
+
+		string::size_type tab = line.rfind('\t');
+		if( tab == string::npos )
+			continue;
+
+		signatures[ line.substr( 0, tab ) ] = line.substr( tab + 1 );
+	}
+}
+
+bool
+DependencyManifest::is_current( const string& output, const string& description )
+{
+	map< string, string >::iterator it = signatures.find(output);
+	if( it == signatures.end() || it->second != Hash().add(description).hex() )
+		return false;
+
+	std::ifstream exists( output.c_str() );
+	if( !exists.good() )
+		return false;
+
+	// carry the unchanged entry over into the next manifest
+	descriptions[output] = description;
+	return true;
+}
+
+void
+DependencyManifest::record( const string& output, const string& description )
+{
+	signatures[output] = Hash().add(description).hex();
+	descriptions[output] = description;
+}
+
+/* Writes all outputs that were recorded or found current in this run;
+ * outputs that weren't considered at all are dropped.
+ */
+void
+DependencyManifest::save()
+{
+	std::ofstream out( filename.c_str() );
+	out << "# pcb2gcode dependency manifest: output file, digest of its inputs" << std::endl;
+
+	for( map< string, string >::iterator it = descriptions.begin(); it != descriptions.end(); it++ ) {
+		out << it->first << '\t' << signatures[it->first] << std::endl;
+
+		std::istringstream description( it->second );
+		string line;
+		while( std::getline( description, line ) )
+			out << '\t' << line << std::endl;
+	}
+}
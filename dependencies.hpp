@@ -0,0 +1,53 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEPENDENCIES_H
+#define DEPENDENCIES_H
+
+#include <string>
+using std::string;
+#include <map>
+using std::map;
+
+#include <boost/noncopyable.hpp>
+
+//! Remembers which inputs and options every output file was generated from.
+/*! Each output is recorded with a description of everything it depends on
+ *  (input digests and settings, one per line). On the next run, an output
+ *  whose description is unchanged and which still exists doesn't need to be
+ *  generated again. The manifest is a text file listing every output with
+ *  the digest of its description, followed by the description itself
+ *  (indented by a tab) for the curious reader.
+ */
+class DependencyManifest : boost::noncopyable
+{
+public:
+	DependencyManifest( const string& filename );
+
+	bool is_current( const string& output, const string& description );
+	void record( const string& output, const string& description );
+	void save();
+
+private:
+	string filename;
+	map< string, string > signatures;
+	map< string, string > descriptions;
+};
+
+#endif // DEPENDENCIES_H
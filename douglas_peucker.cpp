@@ -46,48 +46,20 @@
 #include <algorithm>
 #include <utility>
 #include "douglas_peucker.hpp"
+#include "geometry.hpp"
+#include "log.hpp"
 
-using namespace std;
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 
-float dist_lseg(Point3f& l1, Point3f& l2, Point3f& p) {
-// Compute the 3D distance from the line segment l1..l2 to the point p
-    float dx,dy,dz,d2,t,dist2;
-    dx = l2.x-l1.x; dy = l2.y-l1.y; dz = l2.z-l1.z;
-    d2 = dx*dx + dy*dy + dz*dz;
-    if (d2 == 0) {
-        return 0.0;
-    }
-    t = (dx * (p.x-l1.x) + dy * (p.y-l1.y) + dz * (p.z-l1.z)) / d2;
-    if (t < 0.0) { t = 0.0; }
-    if (t > 1.0) { t = 1.0; }
-    dist2 = pow((p.x - l1.x - t*dx), 2) + \
-            pow((p.y - l1.y - t*dy), 2) + \
-            pow((p.z - l1.z - t*dz), 2);
-    return pow(dist2, 0.5);
-//    return sqrt(dist2);
-}
-
-float rad1(float x1, float y1, float x2, float y2, float x3, float y3) {
-    float x12,y12,x23,y23,x31,y31,den;
-    x12 = x1-x2;
-    y12 = y1-y2;
-    x23 = x2-x3;
-    y23 = y2-y3;
-    x31 = x3-x1;
-    y31 = y3-y1;
-    den = abs(x12 * y23 - x23 * y12);
-    if (abs(den) < FLT_EPSILON) {
-        return FLT_MAX;
-    }
-    return hypot(x12, y12) * hypot(x23, y23) * hypot(x31, y31) / 2 / den;
-}
+using namespace std;
 
-Point2f cent1(float x1, float y1, float x2, float y2, float x3, float y3) {
-    float den, alpha, beta, gamma;
+Point2f cent1(double x1, double y1, double x2, double y2, double x3, double y3) {
+    double den, alpha, beta, gamma;
     Point2f p1(x1,y1), p2(x2,y2), p3(x3,y3);
     den = abs((p1 - p2).cross(p2 - p3));
-    if (abs(den) < FLT_EPSILON) {
-        return Point2f(FLT_MAX, FLT_MAX); // XXX should this be FLT_MAX?
+    if (den <= DBL_EPSILON * (p1 - p2).mag() * (p2 - p3).mag()) { // collinear, as in geometry::circumradii
+        return Point2f(DBL_MAX, DBL_MAX); // XXX should this be DBL_MAX?
     }
     alpha = (p2 - p3).mag2() * (p1 - p2).dot(p1 - p3) / 2 / den / den;
     beta =  (p1 - p3).mag2() * (p2 - p1).dot(p2 - p3) / 2 / den / den;
@@ -108,19 +80,7 @@ Point2f arc_center(int plane, Point3f& p1, Point3f p2, Point3f p3) {
         return cent1(p1.y, p1.z, p2.y, p2.z, p3.y, p3.z);
         break;
     }
-//    return Point2f(FLT_MAX, FLT_MAX);
-}
-
-float arc_rad(int plane, Point3f& p1, Point3f p2, Point3f p3) {
-    switch (plane) {
-    case 17:
-        return rad1(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y);
-    case 18:
-        return rad1(p1.x, p1.z, p2.x, p2.z, p3.x, p3.z);
-    case 19:
-        return rad1(p1.y, p1.z, p2.y, p2.z, p3.y, p3.z);
-    }
-//    return FLT_MAX;
+//    return Point2f(DBL_MAX, DBL_MAX);
 }
 
 Point2f get_pts(int plane, Point3f& p) {
@@ -135,7 +95,7 @@ Point2f get_pts(int plane, Point3f& p) {
 //    return Point2f(p.x, p.y);
 }
 
-int sign(float i) {
+int sign(double i) {
 //    return (i > 0) - (i < 0); // doesn't quite do the behavior needed
     if (abs(i) < FLT_EPSILON) { return 0; }
     if (i < 0) { return -1; }
@@ -143,7 +103,7 @@ int sign(float i) {
 }
 
 bool one_quadrant(int plane, Point2f& c, Point3f& p1, Point3f& p2, Point3f& p3) {
-    float xc,yc,x1,y1,x2,y2,x3,y3;
+    double xc,yc,x1,y1,x2,y2,x3,y3;
     Point2f tmp;
     xc = c.x; yc = c.y;
     tmp = get_pts(plane, p1);
@@ -153,10 +113,10 @@ bool one_quadrant(int plane, Point2f& c, Point3f& p1, Point3f& p2, Point3f& p3)
     tmp = get_pts(plane, p3);
     x3 = tmp.x; y3 = tmp.y;
     
-    cerr << "one_quadrant: plane " << plane << "center(" << xc << "," << yc << ")" << endl;
-    cerr << "one_quadrant: p1(" << x1 << "," << y1 << "," << ")" << endl;
-    cerr << "one_quadrant: p2(" << x2 << "," << y2 << "," << ")" << endl;
-    cerr << "one_quadrant: p3(" << x3 << "," << y3 << "," << ")" << endl;
+    LOG(LOG_DEBUG) << "one_quadrant: plane " << plane << "center(" << xc << "," << yc << ")" << endl;
+    LOG(LOG_DEBUG) << "one_quadrant: p1(" << x1 << "," << y1 << "," << ")" << endl;
+    LOG(LOG_DEBUG) << "one_quadrant: p2(" << x2 << "," << y2 << "," << ")" << endl;
+    LOG(LOG_DEBUG) << "one_quadrant: p3(" << x3 << "," << y3 << "," << ")" << endl;
     typedef pair<int,int> quadrant;
     set<quadrant> signs;
     signs.insert(quadrant(sign(x1-xc), sign(y1-yc)));
@@ -167,7 +127,7 @@ bool one_quadrant(int plane, Point2f& c, Point3f& p1, Point3f& p2, Point3f& p3)
     signs.insert(quadrant(sign(x3-xc), sign(y3-yc)));
 
     if (signs.size() == 1) {
-        cerr << "one_quadrant: result=true1" << endl;
+        LOG(LOG_DEBUG) << "one_quadrant: result=true1" << endl;
         return true;
     }
 
@@ -189,16 +149,16 @@ bool one_quadrant(int plane, Point2f& c, Point3f& p1, Point3f& p2, Point3f& p3)
     }
     
     if (signs.size() == 1) {
-        cerr << "one_quadrant: result=true2" << endl;
+        LOG(LOG_DEBUG) << "one_quadrant: result=true2" << endl;
         return true;
     }
-    cerr << "one_quadrant: result=false" << endl;
+    LOG(LOG_DEBUG) << "one_quadrant: result=false" << endl;
     return false;
 }
 
 #define PI 3.141592654
 bool arc_dir(int plane, Point2f& c, Point3f& p1, Point3f& p2, Point3f& p3) {
-    float xc,yc,x1,y1,x2,y2,x3,y3,theta_start,theta_mid,theta_end;
+    double xc,yc,x1,y1,x2,y2,x3,y3,theta_start,theta_mid,theta_end;
     Point2f tmp;
     xc = c.x; yc = c.y;
     tmp = get_pts(plane, p1);
@@ -222,17 +182,6 @@ bool arc_dir(int plane, Point2f& c, Point3f& p1, Point3f& p2, Point3f& p3) {
     return theta_end < 2*PI;
 }
 
-float arc_dist(int plane, Point2f& cr, Point3f& p, float radius) {
-    switch (plane) {
-        case 17:
-            return abs(hypot(cr.x - p.x, cr.y - p.y) - radius);
-        case 18:
-            return abs(hypot(cr.x - p.x, cr.y - p.z) - radius);
-        case 19:
-            return abs(hypot(cr.x - p.y, cr.y - p.z) - radius);
-    }
-}
-
 string arc_fmt(int plane, Point2f& cr, Point3f& p) {
     stringstream result;
 
@@ -251,6 +200,22 @@ string arc_fmt(int plane, Point2f& cr, Point3f& p) {
     return result.str();
 }
 
+//! the cuts of a smoothing as coordinate arrays for the geometry kernels,
+//! with room for the kernels' results on every level of the recursion
+struct CutArrays {
+    CutArrays(Point3fList& cuts) : base(cuts.begin()), \
+        dist(cuts.size()), radius(cuts.size()) {
+        x.reserve(cuts.size()); y.reserve(cuts.size()); z.reserve(cuts.size());
+        for (Point3fList::iterator p = cuts.begin(); p != cuts.end(); ++p) {
+            x.push_back(p->x); y.push_back(p->y); z.push_back(p->z);
+        }
+    }
+
+    Point3fList::iterator base;
+    vector<double> x, y, z;
+    vector<double> dist, radius;
+};
+
 //Perform Douglas-Peucker simplification on the path 'st' with the specified
 //tolerance.  The 'index' and 'first' argument is for internal use only.
 //
@@ -263,10 +228,11 @@ string arc_fmt(int plane, Point2f& cr, Point3f& p) {
 //be specified only when there is only movement on 2 axes
 MovesVector_t*
 douglas( 
-    float tolerance, \
+    double tolerance, \
     int plane, \
     Point3fList::iterator begin,
     Point3fList::iterator end,
+    CutArrays& a,
     bool first = true) {
 
     MovesVector_t* result = new MovesVector_t;
@@ -278,29 +244,33 @@ douglas(
 
     Point3f ps = *begin;
     Point3f pe = *(end-1);
-    if(ps == pe) { cerr << "DP: Endpoints are equal!" << endl; }
-
-    vector<float> d_v, r_v;
-    for (Point3fList::iterator p = begin; p != end; ++p) {
-        d_v.push_back(dist_lseg(ps, pe, *p));
-        r_v.push_back(arc_rad(plane, ps, *p, pe));
-    }
-    int worst_dist_i = distance(d_v.begin(), max_element(d_v.begin(), d_v.end()));
-    float worst_dist = d_v.at(worst_dist_i);
-    float min_radius = min(FLT_MAX, *min_element(r_v.begin(), r_v.end()));
-    int arc_i = min_radius < FLT_MAX ? \
-        distance(r_v.begin(), min_element(r_v.begin(), r_v.end()))-1 : \
-        distance(begin, end)-1;
-
-    float worst_arc_dist = FLT_MAX;
+    if(ps == pe) { LOG(LOG_DEBUG) << "DP: Endpoints are equal!" << endl; }
+
+    // the coordinates of the span, and those in the plane of the arcs
+    size_t i = distance(a.base, begin), n = distance(begin, end);
+    const double *x = &a.x[i], *y = &a.y[i], *z = &a.z[i];
+    const double* u = plane == 19 ? y : x;
+    const double* v = plane == 17 ? y : z;
+    Point2f p1 = get_pts(plane, ps), p3 = get_pts(plane, pe);
+
+    double* d_v = &a.dist[0];
+    double* r_v = &a.radius[0];
+    geometry::segment_distances(x, y, z, n, ps.x, ps.y, ps.z, pe.x, pe.y, pe.z, d_v);
+    geometry::circumradii(u, v, n, p1.x, p1.y, p3.x, p3.y, r_v);
+
+    int worst_dist_i = max_element(d_v, d_v + n) - d_v;
+    double worst_dist = d_v[worst_dist_i];
+    double* min_r = min_element(r_v, r_v + n);
+    double min_radius = *min_r;
+    int arc_i = min_radius < DBL_MAX ? \
+        (min_r - r_v)-1 : \
+        n-1;
+
+    double worst_arc_dist = DBL_MAX;
     Point2f cr = arc_center(plane, ps, begin[arc_i], pe);
-    if (min_radius < FLT_MAX) {
+    if (min_radius < DBL_MAX) {
         if (one_quadrant(plane, cr, ps, begin[arc_i], pe)) {
-            vector<float> arcdists;
-            for (Point3fList::iterator p = begin; p != end; ++p) {
-                arcdists.push_back(arc_dist(plane, cr, *p, min_radius));
-            }
-            worst_arc_dist = *max_element(arcdists.begin(), arcdists.end());
+            worst_arc_dist = geometry::max_arc_distance(u, v, n, cr.x, cr.y, min_radius);
         }
     }
 
@@ -317,12 +287,12 @@ douglas(
     } else if (worst_dist > tolerance) {
         if (first) { result->push_back(Move(ps)); }
         MovesVector_t* tmp;
-        tmp = douglas(tolerance, plane, begin, begin+worst_dist_i, false);
+        tmp = douglas(tolerance, plane, begin, begin+worst_dist_i, a, false);
         result->reserve(result->size() + tmp->size());
         result->insert(result->end(), tmp->begin(), tmp->end());
         tmp->clear();
         result->push_back(Move(begin[worst_dist_i]));
-        tmp = douglas(tolerance, plane, begin+worst_dist_i, end, false);
+        tmp = douglas(tolerance, plane, begin+worst_dist_i, end, a, false);
         result->reserve(result->size() + tmp->size());
         result->insert(result->end(), tmp->begin(), tmp->end());
         tmp->clear();
@@ -337,17 +307,34 @@ douglas(
    return result;
 }
 
-Gcode::Gcode(float homeheight, \
-        float safetyheight, \
-        float tolerance, \
-        float spindle_speed, \
+//! the simplification of the recorded cuts while write() emits them
+struct Gcode::smoothing_pass {
+    smoothing_pass(size_t count) : next(0), done(count, 0) {}
+
+    size_t next;            // first smoothing not handed out yet
+    vector<char> done;      // not vector<bool>, whose bits share bytes
+    boost::mutex mutex;
+    boost::condition_variable smoothed;
+};
+
+// the cuts are flushed every few points, so the workers take them in runs
+static const size_t smoothing_run = 32;
+
+unsigned int Gcode::smoothing_threads = boost::thread::hardware_concurrency();
+
+Gcode::Gcode(double homeheight, \
+        double safetyheight, \
+        double tolerance, \
+        double spindle_speed, \
         string units, \
         ostream& of) : \
     m_homeheight(homeheight), \
     m_safetyheight(safetyheight), \
     m_tolerance(tolerance), \
     m_speed(spindle_speed), \
-    m_units(units) {
+    m_units(units), \
+    m_endx(0), m_endy(0), m_endz(0), \
+    pass(NULL) {
         m_of = &of;
         plane = 17;
 //        cerr << "Gcode: We were given a tolerance of " << m_tolerance << endl;
@@ -356,16 +343,28 @@ Gcode::Gcode(float homeheight, \
 void Gcode::set_plane(int p) {
     if (p != plane) {
         plane = p;
-        *m_of << "G" << p << endl;
+        program.push_back(boost::bind(&Gcode::write_plane, this, p));
     }
 }
 
-void Gcode::set_feed(float f) {
+void Gcode::write_plane(int p) {
+    *m_of << "G" << p << endl;
+}
+
+void Gcode::set_feed(double f) {
     this->flush();
+    program.push_back(boost::bind(&Gcode::write_feed, this, f));
+}
+
+void Gcode::write_feed(double f) {
     *m_of << "F" << f << endl;
 }
 
 void Gcode::begin() {
+    program.push_back(boost::bind(&Gcode::write_begin, this));
+}
+
+void Gcode::write_begin() {
     *m_of << m_units << endl;
     *m_of << "G00 Z" << m_safetyheight << endl;
     *m_of << "G17 G40" << endl;
@@ -375,52 +374,151 @@ void Gcode::begin() {
 }
 
 void Gcode::flush() {
-    cerr << "flush: flushing " << cuts.size() << " cuts" << endl;
+    LOG(LOG_DEBUG) << "flush: flushing " << cuts.size() << " cuts" << endl;
+    if (cuts.size()) { // no moves, do nothing
+        smoothings.push_back(Smoothing());
+        smoothings.back().cuts.swap(cuts);
+        smoothings.back().plane = plane;
+        program.push_back(boost::bind(&Gcode::write_smoothed, this, smoothings.size() - 1));
+
+        // the simplified moves always end in the last cut
+        Point3f pe = smoothings.back().cuts.back();
+        m_endx = pe.x;
+        m_endy = pe.y;
+        m_endz = pe.z;
+    } else {
+        program.push_back(boost::bind(&Gcode::write_precision, this));
+    }
+}
+
+void Gcode::write_precision() {
     *m_of << setiosflags(ios::fixed) << setprecision(6);
+}
+
+// runs on the smoothing threads: only reads the settings of the Gcode
+void Gcode::smooth(Smoothing& s) {
     MovesVector_t *moves;
-    if (cuts.size()) { // no moves, do nothing
-        Point3f ps = cuts.front();
-        Point3f pe = cuts.back();
-        if (ps == pe and cuts.size() > 1) { // endpoints are equal and we have multiple moves
-            // so let's split
-            cerr << "flush: Same endpoints, splitting vector length of " << cuts.size() << endl;
-            int half = cuts.size() >> 1;
-            cerr << "flush: half = " << half << endl;
-            moves = douglas(m_tolerance, plane, cuts.begin(), cuts.begin()+half);
-            MovesVector_t *tmp = douglas(m_tolerance, plane, cuts.begin()+half, cuts.end());
-            moves->insert(moves->end(), tmp->begin(), tmp->end());
+    CutArrays arrays(s.cuts);
+    Point3f ps = s.cuts.front();
+    Point3f pe = s.cuts.back();
+    if (ps == pe and s.cuts.size() > 1) { // endpoints are equal and we have multiple moves
+        // so let's split
+        LOG(LOG_DEBUG) << "flush: Same endpoints, splitting vector length of " << s.cuts.size() << endl;
+        int half = s.cuts.size() >> 1;
+        LOG(LOG_DEBUG) << "flush: half = " << half << endl;
+        moves = douglas(m_tolerance, s.plane, s.cuts.begin(), s.cuts.begin()+half, arrays);
+        MovesVector_t *tmp = douglas(m_tolerance, s.plane, s.cuts.begin()+half, s.cuts.end(), arrays);
+        moves->insert(moves->end(), tmp->begin(), tmp->end());
+        delete tmp;
+    } else {
+        moves = douglas(m_tolerance, s.plane, s.cuts.begin(), s.cuts.end(), arrays);
+    }
+    s.moves.swap(*moves);
+    delete moves;
+    Point3fList().swap(s.cuts);
+}
+
+void Gcode::smooth_worker(smoothing_pass* pass) {
+    while (true) {
+        size_t first, last;
+        {
+            boost::mutex::scoped_lock lock(pass->mutex);
+            if (pass->next >= smoothings.size()) {
+                return;
+            }
+            first = pass->next;
+            last = min(first + smoothing_run, smoothings.size());
+            pass->next = last;
+        }
+
+        for (size_t i = first; i < last; ++i) {
+            smooth(smoothings[i]);
+        }
+
+        {
+            boost::mutex::scoped_lock lock(pass->mutex);
+            fill(pass->done.begin() + first, pass->done.begin() + last, 1);
+        }
+        pass->smoothed.notify_all();
+    }
+}
+
+void Gcode::write_smoothed(size_t index) {
+    Smoothing& s = smoothings[index];
+    if (pass) {
+        boost::mutex::scoped_lock lock(pass->mutex);
+        while (!pass->done[index]) {
+            pass->smoothed.wait(lock);
+        }
+    } else {
+        smooth(s);
+    }
+
+    write_precision();
+    for (MovesVector_t::iterator m = s.moves.begin(); m != s.moves.end(); ++m) {
+        Move& t = *m;
+        if (t.center.size()) {
+            *m_of << t.gc << " X" << t.x << " Y" << t.y << " Z" << t.z << t.center << endl;
+            m_lastgc = "";
+            m_lastx = t.x;
+            m_lasty = t.y;
+            m_lastz = t.z;
         } else {
-            moves = douglas(m_tolerance, plane, cuts.begin(), cuts.end());
+            this->move_common(t, "G01");
         }
-        for (MovesVector_t::iterator m = moves->begin(); m != moves->end(); ++m) {
-            Move t = *m;
-            if (t.center.size()) {
-                *m_of << t.gc << " X" << t.x << " Y" << t.y << " Z" << t.z << t.center << endl;
-                m_lastgc = "";
-                m_lastx = t.x;
-                m_lasty = t.y;
-                m_lastz = t.z;
-            } else {
-                this->move_common(t, "G01");
-            }
+    }
+    MovesVector_t().swap(s.moves);
+}
+
+// Writes the commands recorded so far. The cuts still buffered stay
+// buffered, as they would have before the next flush.
+void Gcode::write() {
+    smoothing_pass smoothing(smoothings.size());
+    boost::thread_group pool;
+
+    unsigned int threads = min<size_t>(max(smoothing_threads, 1U), \
+        (smoothings.size() + smoothing_run - 1) / smoothing_run);
+    if (threads > 1) {
+        pass = &smoothing;
+        for (unsigned int i = 0; i < threads; ++i) {
+            pool.create_thread(boost::bind(&Gcode::smooth_worker, this, pass));
         }
-        moves->clear();
-        delete moves;
     }
-    cuts.clear();
+
+    for (size_t i = 0; i < program.size(); ++i) {
+        program[i]();
+    }
+
+    pool.join_all();
+    pass = NULL;
+    program.clear();
+    smoothings.clear();
 }
 
 void Gcode::end() {
     flush();
     safety();
+    program.push_back(boost::bind(&Gcode::write_end, this));
+    write();
+}
+
+void Gcode::write_end() {
     *m_of << "M2" << endl;
 }
 
 void Gcode::exactpath() {
+    program.push_back(boost::bind(&Gcode::write_exactpath, this));
+}
+
+void Gcode::write_exactpath() {
     *m_of << "G61" << endl;
 }
 
-void Gcode::continuous(float t) {
+void Gcode::continuous(double t) {
+    program.push_back(boost::bind(&Gcode::write_continuous, this, t));
+}
+
+void Gcode::write_continuous(double t) {
     if (t > 0.0) {
         *m_of << "G64 P" << t << endl;
     } else {
@@ -430,11 +528,14 @@ void Gcode::continuous(float t) {
 
 void Gcode::rapid(Move& move) {
     flush();
-    move_common(move, "G00");
+    program.push_back(boost::bind(&Gcode::move_common, this, move, string("G00")));
+    if (move.nx and !isnan(move.x)) { m_endx = move.x; }
+    if (move.ny and !isnan(move.y)) { m_endy = move.y; }
+    if (move.nz and !isnan(move.z)) { m_endz = move.z; }
 }
 
-void Gcode::move_common(Move& move, string gc) {
-    float x,y,z;
+void Gcode::move_common(const Move& move, string gc) {
+    double x,y,z;
     stringstream ss;
     ss << setiosflags(ios::fixed) << setprecision(6);
     string s;
@@ -459,12 +560,12 @@ void Gcode::move_common(Move& move, string gc) {
 }
 
 void Gcode::cut(Move& move) {
-    float x,y,z,lx,ly,lz,dx,dy,dz;
+    double x,y,z,lx,ly,lz,dx,dy,dz;
     if (cuts.size()) {
         Point3f t = cuts.back();
         lx = t.x; ly = t.y; lz = t.z;
     } else {
-        lx = m_lastx; ly = m_lasty; lz = m_lastz;
+        lx = m_endx; ly = m_endy; lz = m_endz;
     }
     x = move.nx ? move.x : lx;
     y = move.ny ? move.y : ly;
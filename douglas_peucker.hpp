@@ -24,32 +24,35 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <deque>
 #include <cmath>
 #include <float.h>
 
+#include <boost/function.hpp>
+
 using namespace std;
 
 class Point2f {
 public:
     Point2f () {}
-    Point2f (float a, float b): x(a), y(b) {}
+    Point2f (double a, double b): x(a), y(b) {}
 //    virtual ~Point2f ();
 
-    float x;
-    float y;
+    double x;
+    double y;
     Point2f operator-(const Point2f &rhs) const { return Point2f(x - rhs.x, y - rhs.y); }
     Point2f operator+(const Point2f &rhs) const { return Point2f(x + rhs.x, y + rhs.y); }
-    Point2f operator*(const float &rhs) const { return Point2f(x * rhs, y * rhs); }
-    float cross(const Point2f &other) const { return x * other.y + y * other.x; }
-    float dot(const Point2f &other) const { return x * other.x + y * other.y; }
-    float mag() { return hypot(x, y); }
-    float mag2() { return pow(x, 2) + pow(y, 2); }
+    Point2f operator*(const double &rhs) const { return Point2f(x * rhs, y * rhs); }
+    double cross(const Point2f &other) const { return x * other.y - y * other.x; }
+    double dot(const Point2f &other) const { return x * other.x + y * other.y; }
+    double mag() { return hypot(x, y); }
+    double mag2() { return x * x + y * y; }
 
 };
 
 struct Point3f {
-    float x, y, z;
-    Point3f(float a, float b, float c) : x(a), y(b), z(c) {}
+    double x, y, z;
+    Point3f(double a, double b, double c) : x(a), y(b), z(c) {}
     bool operator==(const Point3f &rhs) const { return x==rhs.x and y==rhs.y and z==rhs.z; }
 };
 
@@ -62,13 +65,13 @@ public:
         x(p.x), y(p.y), z(p.z) {}
     virtual ~Move () {}
 
-    float x, y, z, i, j, k;
+    double x, y, z, i, j, k;
     bool nx, ny, nz, ni, nj, nk;
     string gc, center;
 
-    Move& X(float value) { x=value; nx=true; return *this;}
-    Move& Y(float value) { y=value; ny=true; return *this;}
-    Move& Z(float value) { z=value; nz=true; return *this;}
+    Move& X(double value) { x=value; nx=true; return *this;}
+    Move& Y(double value) { y=value; ny=true; return *this;}
+    Move& Z(double value) { z=value; nz=true; return *this;}
     Move& Center(string value) { center=value; return *this;}
     Move& GC(string value) { gc=value; return *this;}
 };
@@ -78,12 +81,16 @@ public:
 typedef vector<Move> MovesVector_t;
 typedef vector<Point3f> Point3fList;
 
+// The commands are recorded and only written by write() and end(). The
+// buffered cuts are simplified on several threads in the meantime, and a
+// single writer emits the results in the order they were recorded, so the
+// output doesn't depend on the number of threads.
 class Gcode {
 public:
-    Gcode (float homeheight = 1.5, \
-            float safetyheight = 0.04, \
-            float tolerance = 0.001, \
-            float spindle_speed = 1000, \
+    Gcode (double homeheight = 1.5, \
+            double safetyheight = 0.04, \
+            double tolerance = 0.001, \
+            double spindle_speed = 1000, \
             string units = "G20", \
             ostream& of = cout);
             
@@ -96,28 +103,62 @@ public:
     void flush();
     void end();
     void exactpath();
-    void continuous(float tolerance);
+    void continuous(double tolerance);
     void rapid(Move& move);
-    void set_feed(float);
+    void set_feed(double);
     void cut(Move& move);
     void home();
     void safety();
+    void write();
+
+    //! number of threads simplifying the cuts
+    static void set_threads(unsigned int threads) { smoothing_threads = threads; }
 private:
     /* data */
-    float m_lastx;
-    float m_lasty;
-    float m_lastz;
+    double m_lastx;
+    double m_lasty;
+    double m_lastz;
     string m_lastgc;
-    float m_homeheight;
-    float m_safetyheight;
-    float m_tolerance;
-    float m_speed;
+    double m_homeheight;
+    double m_safetyheight;
+    double m_tolerance;
+    double m_speed;
     int plane;
     ostream* m_of;
     string m_units;
     Point3fList cuts;
 
-    void move_common(Move& move, string gcode);
+    // where the recorded commands leave the tool, m_last* is where the
+    // written ones did
+    double m_endx;
+    double m_endy;
+    double m_endz;
+
+    struct Smoothing {
+        Point3fList cuts;
+        int plane;
+        MovesVector_t moves;
+    };
+    struct smoothing_pass;
+
+    // deques, which don't copy the recorded commands when they grow
+    deque< boost::function<void ()> > program;
+    deque<Smoothing> smoothings;
+    smoothing_pass* pass;
+    static unsigned int smoothing_threads;
+
+    void smooth(Smoothing& s);
+    void smooth_worker(smoothing_pass* pass);
+
+    void write_plane(int p);
+    void write_feed(double f);
+    void write_begin();
+    void write_end();
+    void write_exactpath();
+    void write_continuous(double t);
+    void write_precision();
+    void write_smoothed(size_t index);
+    void move_common(const Move& move, string gcode);
 };
 
 #endif /* end of include guard: DOUGLAS_PEUCKER_8Z613VV3 */
@@ -27,6 +27,9 @@ using std::endl;
 using namespace std;
 
 #include "drill.hpp"
+#include "gerberimporter.hpp"
+#include "log.hpp"
+#include "output_file.hpp"
 
 #include <cstring>
 #include <boost/scoped_array.hpp>
@@ -38,13 +41,16 @@ using std::pair;
 ExcellonProcessor::ExcellonProcessor( string drillfile, const ivalue_t board_width ) : board_width(board_width)
 {
 	bDoSVG = false;
-	project = gerbv_create_project();
 
 	const char* cfilename = drillfile.c_str();
 	boost::scoped_array<char> filename( new char[strlen(cfilename) + 1] );
 	strcpy(filename.get(), cfilename);
 
-	gerbv_open_layer_from_filename(project, filename.get());
+	{
+		boost::mutex::scoped_lock lock( gerbv_mutex );
+		project = gerbv_create_project();
+		gerbv_open_layer_from_filename(project, filename.get());
+	}
 	if( project->file[0] == NULL) throw drill_exception();
 
 	preamble = string("G94     ( Inches per minute feed rate. )\n");
@@ -82,7 +88,7 @@ ExcellonProcessor::export_ngc( const string of_name, shared_ptr<Driller> driller
 	int rad = 1.;
 	
 	// open output file
-	std::ofstream of; of.open( of_name.c_str() );
+	OutputFile of( of_name );
 
 	shared_ptr<const map<int,drillbit> > bits = get_bits();
 	shared_ptr<const map<int,icoords> > holes = get_holes();	
@@ -121,11 +127,8 @@ ExcellonProcessor::export_ngc( const string of_name, shared_ptr<Driller> driller
 		
 		//SVG EXPORTER
 		if (bDoSVG) {
-			//set a random color
+			//set a random color for the holes of this bit
 			svgexpo->set_rand_color();
-			//draw first circle
-			svgexpo->circle( (double_mirror_axis - coord_iter->first), coord_iter->second, rad);		
-			svgexpo->stroke();
 		}
 		
 		
@@ -138,7 +141,6 @@ ExcellonProcessor::export_ngc( const string of_name, shared_ptr<Driller> driller
 			if (bDoSVG) {
 				//make a whole
 				svgexpo->circle( (double_mirror_axis - coord_iter->first), coord_iter->second, rad);
-				svgexpo->stroke();
 			}
 			
 			++coord_iter;
@@ -156,7 +158,7 @@ ExcellonProcessor::export_ngc( const string of_name, shared_ptr<Driller> driller
 	of.close();
 }
 
-void ExcellonProcessor::millhole(std::ofstream &of,float x, float y,  shared_ptr<Cutter> cutter,float holediameter)
+void ExcellonProcessor::millhole(std::ostream &of,float x, float y,  shared_ptr<Cutter> cutter,float holediameter)
 {
 	g_assert(cutter);
 	double cutdiameter=cutter->tool_diameter;
@@ -201,10 +203,10 @@ ExcellonProcessor::export_ngc( const string outputname,  shared_ptr<Cutter> targ
 
 	g_assert( mirrored == true );
 	g_assert( mirror_absolute == false );
-	cerr << "Currently Drilling "<< endl;
+	LOG(LOG_INFO) << "Currently Drilling "<< endl;
 
 	// open output file
-	std::ofstream of; of.open( outputname.c_str() );
+	OutputFile of( outputname );
 
 	shared_ptr<const map<int,drillbit> > bits = get_bits();
 	shared_ptr<const map<int,icoords> > holes = get_holes();	
@@ -310,6 +312,7 @@ ExcellonProcessor::get_holes()
 
 ExcellonProcessor::~ExcellonProcessor()
 {
+	boost::mutex::scoped_lock lock( gerbv_mutex );
 	gerbv_destroy_project(project);
 }
 
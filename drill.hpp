@@ -101,7 +101,7 @@ private:
 	string preamble,postamble;
 
 private: //methods
-	void millhole(std::ofstream &of,float x, float y,  shared_ptr<Cutter> cutter,float holediameter);
+	void millhole(std::ostream &of,float x, float y,  shared_ptr<Cutter> cutter,float holediameter);
 };
 
 
@@ -0,0 +1,139 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "estimator.hpp"
+
+#include <cmath>
+#include <iomanip>
+
+#include <boost/foreach.hpp>
+
+// average length of a "G01 X... Y... F..." line as written by NGC_Exporter
+static const double bytes_per_line = 36;
+// fraction of the outline pixels that are corners of their chain code, i.e.
+// not in the middle of a straight or diagonal run
+static const double emitted_pixel_ratio = 0.5;
+
+CostEstimator::CostEstimator( shared_ptr<Board> board )
+{
+	this->board = board;
+
+	board->calculateDimensions();
+
+	BOOST_FOREACH( string layername, board->list_prepared_layers() ) {
+		estimates.push_back( estimate_layer(layername) );
+	}
+}
+
+layer_estimate
+CostEstimator::estimate_layer( string layername )
+{
+	layer_estimate e;
+	uint dpi = board->get_dpi();
+	ivalue_t width = board->get_max_x() - board->get_min_x();
+	ivalue_t height = board->get_max_y() - board->get_min_y();
+
+	e.name = layername;
+	e.surface_bytes = Surface::get_memory_footprint( dpi, width, height );
+	e.width_px = width * dpi;
+	e.height_px = height * dpi;
+
+	layer_statistics stats = board->get_importer(layername)->get_statistics();
+	e.components = stats.flashes + stats.strokes;
+
+	shared_ptr<RoutingMill> mill = board->get_manufacturer(layername);
+	shared_ptr<Isolator> isolator = boost::dynamic_pointer_cast<Isolator>(mill);
+	shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>(mill);
+
+	uint passes = isolator ? isolator->extra_passes + 1 : 1;
+	double radius = mill ? mill->tool_diameter / 2 : 0;
+	e.grow_iterations = uint( radius * dpi ) * passes;
+
+	// every pass traces the copper outlines grown by the tool radius,
+	// which adds a circle's circumference around each component
+	double contour_length = 0;
+	for( uint pass = 1; pass <= passes; pass++ )
+		contour_length += stats.outline_length + e.components * 2 * M_PI * radius * pass;
+
+	// cutting may be repeated in several depth steps
+	uint depth_steps = 1;
+	if( cutter && cutter->do_steps && cutter->stepsize > 0 )
+		depth_steps += uint( std::abs( cutter->zwork / cutter->stepsize ) );
+
+	e.gcode_bytes = contour_length * dpi * emitted_pixel_ratio * bytes_per_line * depth_steps;
+
+	return e;
+}
+
+void
+CostEstimator::print_summary( std::ostream& out )
+{
+	size_t total_surface = 0;
+	size_t total_gcode = 0;
+
+	out << "Estimate for " << estimates.size() << " layer(s) at " << board->get_dpi() << " dpi, board "
+	    << board->get_max_x() - board->get_min_x() << "in x "
+	    << board->get_max_y() - board->get_min_y() << "in" << std::endl;
+
+	BOOST_FOREACH( layer_estimate& e, estimates ) {
+		out << "  " << e.name << ": "
+		    << e.width_px << "x" << e.height_px << " px surface ("
+		    << e.surface_bytes / ( 1024 * 1024 ) << " MiB), ~"
+		    << e.components << " components, "
+		    << e.grow_iterations << " grow iterations, ~"
+		    << e.gcode_bytes / 1024 << " KiB G-code" << std::endl;
+		total_surface += e.surface_bytes;
+		total_gcode += e.gcode_bytes;
+	}
+
+	out << "Total: " << total_surface / ( 1024 * 1024 ) << " MiB surface memory, ~"
+	    << total_gcode / 1024 << " KiB G-code" << std::endl;
+}
+
+void
+CostEstimator::write_json( std::ostream& out )
+{
+	size_t total_surface = 0;
+	size_t total_gcode = 0;
+
+	out << "{\n"
+	    << "  \"dpi\": " << board->get_dpi() << ",\n"
+	    << "  \"width_in\": " << board->get_max_x() - board->get_min_x() << ",\n"
+	    << "  \"height_in\": " << board->get_max_y() - board->get_min_y() << ",\n"
+	    << "  \"layers\": [";
+
+	for( uint i = 0; i < estimates.size(); i++ ) {
+		layer_estimate& e = estimates[i];
+		out << ( i ? ",\n" : "\n" )
+		    << "    { \"name\": \"" << e.name << "\""
+		    << ", \"width_px\": " << e.width_px
+		    << ", \"height_px\": " << e.height_px
+		    << ", \"surface_bytes\": " << e.surface_bytes
+		    << ", \"components\": " << e.components
+		    << ", \"grow_iterations\": " << e.grow_iterations
+		    << ", \"gcode_bytes\": " << e.gcode_bytes << " }";
+		total_surface += e.surface_bytes;
+		total_gcode += e.gcode_bytes;
+	}
+
+	out << "\n  ],\n"
+	    << "  \"total_surface_bytes\": " << total_surface << ",\n"
+	    << "  \"total_gcode_bytes\": " << total_gcode << "\n"
+	    << "}\n";
+}
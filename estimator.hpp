@@ -0,0 +1,66 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <ostream>
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include "board.hpp"
+
+//! predicted cost of processing a single layer
+struct layer_estimate
+{
+	string name;
+	uint width_px;
+	uint height_px;
+	size_t surface_bytes;
+	uint components;
+	uint grow_iterations;
+	size_t gcode_bytes;
+};
+
+//! Predicts memory, work and output size of a run without rendering anything.
+/*! The figures are derived from the board dimensions calculated by the Board
+ *  and the statistics gerbv collects while parsing. They are rough
+ *  approximations meant for scheduling jobs, not exact numbers.
+ */
+class CostEstimator
+{
+public:
+	CostEstimator( shared_ptr<Board> board );
+
+	void print_summary( std::ostream& out );
+	void write_json( std::ostream& out );
+
+private:
+	layer_estimate estimate_layer( string layername );
+
+	shared_ptr<Board> board;
+	vector<layer_estimate> estimates;
+};
+
+#endif // ESTIMATOR_H
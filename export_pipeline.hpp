@@ -0,0 +1,240 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPORT_PIPELINE_H
+#define EXPORT_PIPELINE_H
+
+#include <cstdlib>
+#include <vector>
+using std::vector;
+
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include "feed_planner.hpp"
+#include "mill.hpp"
+#include "toolpath.hpp"
+#include "svg_exporter.hpp"
+
+/*! The stages the toolpaths of a layer go through on their way into a
+ *  G-code file. Every stage has the same calls as the sink at the end:
+ *
+ *    begin_contour( x, y )	retract and move to the start of a contour
+ *    begin_pass( z )		plunge for one pass over it
+ *    point( x, y )		cut to the point
+ *    end_pass()
+ *    end_contour()
+ *
+ *  and hands them on to the next stage, which is a template parameter, so
+ *  that the chain is put together at compile time and the points don't go
+ *  through virtual calls.
+ */
+namespace pipeline
+{
+	//! drops the points that line up with both neighbours on the X or Y axis
+	/*! The traced toolpaths run along the pixels, so most of their points
+	 *  are in the middle of horizontal or vertical runs. The first and the
+	 *  last point of a pass are always kept.
+	 */
+	template <class Next>
+	class CollinearFilter
+	{
+	public:
+		CollinearFilter( Next& next ) : next(next), count(0) {}
+
+		void begin_contour( double x, double y ) { next.begin_contour( x, y ); }
+		void begin_pass( double z ) { count = 0; next.begin_pass( z ); }
+
+		void point( double x, double y )
+		{
+			if( count == 0 )
+				next.point( x, y );
+			else if( count >= 2 &&
+				 !( ( last_x == cur_x && cur_x == x ) ||
+				    ( last_y == cur_y && cur_y == y ) ) )
+				next.point( cur_x, cur_y );
+
+			last_x = cur_x;
+			last_y = cur_y;
+			cur_x = x;
+			cur_y = y;
+			count++;
+		}
+
+		void end_pass()
+		{
+			if( count >= 2 )
+				next.point( cur_x, cur_y );
+			next.end_pass();
+		}
+
+		void end_contour() { next.end_contour(); }
+
+	private:
+		Next& next;
+		size_t count;		// points of the pass so far
+		double last_x, last_y;	// the point before the held one
+		double cur_x, cur_y;	// held until its successor is known
+	};
+
+	//! draws the first pass of every contour into the SVG preview
+	template <class Next>
+	class SvgTee
+	{
+	public:
+		SvgTee( Next& next, shared_ptr<SVG_Exporter> svg ) : next(next), svg(svg), first_pass(true) {}
+
+		void begin_contour( double x, double y )
+		{
+			next.begin_contour( x, y );
+			svg->move_to( x, y );
+			first_pass = true;
+		}
+
+		void begin_pass( double z ) { next.begin_pass( z ); }
+
+		void point( double x, double y )
+		{
+			next.point( x, y );
+			if( first_pass )
+				svg->line_to( x, y );
+		}
+
+		void end_pass()
+		{
+			next.end_pass();
+			svg->close_path();
+			first_pass = false;
+		}
+
+		void end_contour() { next.end_contour(); }
+
+	private:
+		Next& next;
+		shared_ptr<SVG_Exporter> svg;
+		bool first_pass;
+	};
+
+	//! collects every pass and lets the FeedPlanner merge its segments
+	template <class Next>
+	class Planner
+	{
+	public:
+		Planner( Next& next, FeedPlanner& planner, double feed ) : next(next), planner(planner), feed(feed) {}
+
+		void begin_contour( double x, double y ) { next.begin_contour( x, y ); }
+
+		void begin_pass( double z )
+		{
+			xs.clear();
+			ys.clear();
+			next.begin_pass( z );
+		}
+
+		void point( double x, double y )
+		{
+			xs.push_back( x );
+			ys.push_back( y );
+		}
+
+		void end_pass()
+		{
+			planner.plan_pass( xs, ys, feed );
+			for( size_t i = 0; i < xs.size(); i++ )
+				next.point( xs[i], ys[i] );
+			next.end_pass();
+		}
+
+		void end_contour() { next.end_contour(); }
+
+	private:
+		Next& next;
+		FeedPlanner& planner;
+		double feed;
+		vector<double> xs, ys;
+	};
+
+	//! the source: feeds the passes over every contour into stage
+	/*! Cutters with do_steps go down to zwork in passes of stepsize,
+	 *  everything else does one pass at zwork.
+	 */
+	template <class Stage>
+	void feed( const ToolpathSet& toolpaths, shared_ptr<RoutingMill> mill, Stage& stage )
+	{
+		shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>( mill );
+
+		for( size_t contour = 0; contour < toolpaths.size(); contour++ ) {
+			size_t begin = toolpaths.contour_begin(contour);
+			size_t end = toolpaths.contour_end(contour);
+
+			stage.begin_contour( toolpaths.x(begin), toolpaths.y(begin) );
+
+			double z, z_step;
+			if( cutter && cutter->do_steps ) {
+				z_step = cutter->stepsize;
+				z = mill->zwork + z_step * abs( int( mill->zwork / z_step ) );
+			} else {
+				z_step = 0;
+				z = mill->zwork;
+			}
+
+			do {
+				stage.begin_pass( z );
+				for( size_t i = begin; i != end; i++ )
+					stage.point( toolpaths.x(i), toolpaths.y(i) );
+				stage.end_pass();
+				z -= z_step;
+			} while( z_step > 0 && z >= mill->zwork );
+
+			stage.end_contour();
+		}
+	}
+
+	//! feeds the toolpaths through the collinear filter and, if planner
+	//! is set, the feed planning into stage
+	template <class Stage>
+	void plan( const ToolpathSet& toolpaths, shared_ptr<RoutingMill> mill,
+		   shared_ptr<FeedPlanner> planner, Stage& stage )
+	{
+		if( planner ) {
+			Planner<Stage> planning( stage, *planner, mill->feed );
+			CollinearFilter< Planner<Stage> > filter( planning );
+			feed( toolpaths, mill, filter );
+		} else {
+			CollinearFilter<Stage> filter( stage );
+			feed( toolpaths, mill, filter );
+		}
+	}
+
+	//! runs the toolpaths through the collinear filter, the feed planning
+	//! and the SVG preview into sink, leaving out the stages that aren't set
+	template <class Sink>
+	void export_toolpaths( const ToolpathSet& toolpaths, shared_ptr<RoutingMill> mill,
+			       shared_ptr<SVG_Exporter> svg, shared_ptr<FeedPlanner> planner, Sink& sink )
+	{
+		if( svg ) {
+			SvgTee<Sink> tee( sink, svg );
+			plan( toolpaths, mill, planner, tee );
+		} else {
+			plan( toolpaths, mill, planner, sink );
+		}
+	}
+}
+
+#endif // EXPORT_PIPELINE_H
@@ -0,0 +1,209 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "feed_planner.hpp"
+#include "geometry.hpp"
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/foreach.hpp>
+
+using std::min;
+using std::max;
+
+// most points merged into one segment, bounding the work per point
+static const size_t merge_window = 64;
+
+FeedPlanner::FeedPlanner( double acceleration, double junction_deviation )
+	: acceleration(acceleration), junction_deviation(junction_deviation),
+	  zeros( merge_window ), distances( merge_window )
+{
+}
+
+void
+FeedPlanner::begin_output( string name )
+{
+	output_plan plan = { name, 0, 0, 0, 0 };
+	outputs.push_back( plan );
+}
+
+void
+FeedPlanner::plan_pass( vector<double>& xs, vector<double>& ys, double feed )
+{
+	if( outputs.empty() )
+		begin_output( "" );
+	output_plan& plan = outputs.back();
+
+	if( xs.size() < 2 )
+		return;
+
+	plan.segments_before += xs.size() - 1;
+	plan.seconds_before += planned_time( xs, ys, feed );
+
+	merge( xs, ys );
+
+	plan.segments_after += xs.size() - 1;
+	plan.seconds_after += planned_time( xs, ys, feed );
+}
+
+/* Greedily extends every segment over the following points as long as all
+ * the points it skips are within the junction deviation of it. A segment
+ * that ends where it began, like an excursion into a gap and back, is a
+ * point, and the skipped points have to be near that point.
+ */
+void
+FeedPlanner::merge( vector<double>& xs, vector<double>& ys )
+{
+	const size_t n = xs.size();
+	size_t kept = 1;	// the first point stays
+	size_t from = 0;	// start of the segment being extended
+
+	for( size_t to = 2; to < n; to++ ) {
+		bool fits = to - from <= merge_window;
+		if( fits ) {
+			size_t skipped = to - from - 1;
+			if( xs[from] == xs[to] && ys[from] == ys[to] ) {
+				// segment_distances gives 0 for all points then
+				for( size_t i = 0; i < skipped; i++ ) {
+					const double dx = xs[from + 1 + i] - xs[from];
+					const double dy = ys[from + 1 + i] - ys[from];
+					distances[i] = sqrt( dx * dx + dy * dy );
+				}
+			} else {
+				geometry::segment_distances( &xs[from + 1], &ys[from + 1], &zeros[0], skipped,
+							     xs[from], ys[from], 0., xs[to], ys[to], 0., &distances[0] );
+			}
+			fits = *std::max_element( distances.begin(), distances.begin() + skipped ) <= junction_deviation;
+		}
+
+		if( !fits ) {
+			from = to - 1;
+			xs[kept] = xs[from];
+			ys[kept] = ys[from];
+			kept++;
+		}
+	}
+
+	// the last point stays
+	xs[kept] = xs[n - 1];
+	ys[kept] = ys[n - 1];
+	xs.resize( kept + 1 );
+	ys.resize( kept + 1 );
+}
+
+/* The squared speed at which the tool can take the corner at interior point
+ * i, from the radius of the circle that touches both segments and passes the
+ * corner at the junction deviation.
+ */
+double
+FeedPlanner::junction_speed2( size_t i, double feed_speed2 ) const
+{
+	const double ux = ( px[i] - px[i - 1] ) / lengths[i - 1], uy = ( py[i] - py[i - 1] ) / lengths[i - 1];
+	const double vx = ( px[i + 1] - px[i] ) / lengths[i], vy = ( py[i + 1] - py[i] ) / lengths[i];
+
+	// the angle between the segments, 180 degrees when going straight on
+	const double cos_theta = -( ux * vx + uy * vy );
+	if( cos_theta < -0.999999 )
+		return feed_speed2;
+	if( cos_theta > 0.999999 )
+		return 0;
+
+	const double sin_half_theta = sqrt( 0.5 * ( 1 - cos_theta ) );
+	return min( feed_speed2, acceleration * junction_deviation * sin_half_theta / ( 1 - sin_half_theta ) );
+}
+
+//! time to run a segment with a trapezoidal (or triangular) speed profile
+double
+FeedPlanner::segment_time( double length, double entry, double exit, double cruise ) const
+{
+	const double accelerating = ( cruise * cruise - entry * entry ) / ( 2 * acceleration );
+	const double braking = ( cruise * cruise - exit * exit ) / ( 2 * acceleration );
+
+	if( accelerating + braking <= length )
+		return ( cruise - entry ) / acceleration + ( cruise - exit ) / acceleration
+			+ ( length - accelerating - braking ) / cruise;
+
+	const double peak = sqrt( ( 2 * acceleration * length + entry * entry + exit * exit ) / 2 );
+	return ( peak - entry ) / acceleration + ( peak - exit ) / acceleration;
+}
+
+double
+FeedPlanner::planned_time( const vector<double>& xs, const vector<double>& ys, double feed )
+{
+	px.clear();
+	py.clear();
+	for( size_t i = 0; i < xs.size(); i++ ) {
+		if( i == 0 || xs[i] != px.back() || ys[i] != py.back() ) {
+			px.push_back( xs[i] );
+			py.push_back( ys[i] );
+		}
+	}
+
+	const size_t n = px.size();
+	if( n < 2 )
+		return 0;
+
+	lengths.resize( n - 1 );
+	for( size_t i = 0; i + 1 < n; i++ )
+		lengths[i] = sqrt( ( px[i + 1] - px[i] ) * ( px[i + 1] - px[i] ) + ( py[i + 1] - py[i] ) * ( py[i + 1] - py[i] ) );
+
+	// the pass starts and ends at a stop for the plunge and the retract
+	const double cruise = feed / 60;
+	speed2.resize( n );
+	speed2[0] = speed2[n - 1] = 0;
+	for( size_t i = 1; i + 1 < n; i++ )
+		speed2[i] = junction_speed2( i, cruise * cruise );
+
+	for( size_t i = 0; i + 1 < n; i++ )
+		speed2[i + 1] = min( speed2[i + 1], speed2[i] + 2 * acceleration * lengths[i] );
+	for( size_t i = n - 1; i > 0; i-- )
+		speed2[i - 1] = min( speed2[i - 1], speed2[i] + 2 * acceleration * lengths[i - 1] );
+
+	double seconds = 0;
+	for( size_t i = 0; i + 1 < n; i++ )
+		seconds += segment_time( lengths[i], sqrt( speed2[i] ), sqrt( speed2[i + 1] ), cruise );
+	return seconds;
+}
+
+void
+FeedPlanner::print_summary( std::ostream& out )
+{
+	double total_before = 0, total_after = 0;
+
+	out << "Feed planning at " << acceleration << " in/s^2 and "
+	    << junction_deviation << "in junction deviation:" << std::endl;
+
+	BOOST_FOREACH( output_plan& plan, outputs ) {
+		out << "  " << plan.name << ": "
+		    << plan.segments_before << " -> " << plan.segments_after << " segments, cutting "
+		    << JobStatistics::format_time( plan.seconds_before ) << " -> "
+		    << JobStatistics::format_time( plan.seconds_after )
+		    << std::endl;
+		total_before += plan.seconds_before;
+		total_after += plan.seconds_after;
+	}
+
+	std::ostringstream speedup;
+	speedup << std::setprecision(3) << ( total_after > 0 ? total_before / total_after : 1 );
+	out << "Expected speedup: " << speedup.str() << "x" << std::endl;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FEED_PLANNER_H
+#define FEED_PLANNER_H
+
+#include <ostream>
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+
+//! Reshapes the cutting passes so that a controller can run them near full feed.
+/*! The traced toolpaths are staircases of short segments, and a controller
+ *  with look-ahead has to slow down at every corner of them. The planner
+ *  merges the runs of segments that stay within the junction deviation of
+ *  a straight line, so the remaining corners are fewer and flatter.
+ *
+ *  To tell how much that helps, it plans the speeds of each pass before
+ *  and after the merge like such a controller: every corner gets the speed
+ *  at which the tool stays within the junction deviation of it at the given
+ *  acceleration, and a forward and a backward pass over the segments limit
+ *  the speeds to what the acceleration can reach from the stops at both
+ *  ends. Lengths are in inches, feeds in ipm, acceleration in in/s^2.
+ */
+class FeedPlanner : boost::noncopyable
+{
+public:
+	FeedPlanner( double acceleration, double junction_deviation );
+
+	//! the following passes belong to the named output
+	void begin_output( string name );
+
+	//! merges the segments of a pass in place
+	void plan_pass( vector<double>& xs, vector<double>& ys, double feed );
+
+	//! seconds the controller takes for a pass at feed, as planned above
+	double planned_time( const vector<double>& xs, const vector<double>& ys, double feed );
+
+	void print_summary( std::ostream& out );
+
+private:
+	struct output_plan {
+		string name;
+		size_t segments_before, segments_after;
+		double seconds_before, seconds_after;
+	};
+
+	void merge( vector<double>& xs, vector<double>& ys );
+	double junction_speed2( size_t i, double feed_speed2 ) const;
+	double segment_time( double length, double entry, double exit, double cruise ) const;
+
+	const double acceleration;
+	const double junction_deviation;
+	vector<output_plan> outputs;
+
+	// reused between the passes
+	vector<double> px, py;		// the pass without repeated points
+	vector<double> lengths;		// of the segments
+	vector<double> speed2;		// squared speed at every point
+	vector<double> zeros, distances;
+};
+
+#endif // FEED_PLANNER_H
@@ -0,0 +1,122 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geometry.hpp"
+
+#ifdef GEOMETRY_SSE2
+#include <emmintrin.h>
+
+namespace geometry
+{
+
+/* The SSE2 kernels do two points at a time, in the same order of
+ * operations as the plain ones, which do the point left over.
+ */
+
+template <>
+void segment_distances<double>( const double* x, const double* y, const double* z, size_t n,
+				double ax, double ay, double az, double bx, double by, double bz,
+				double* dist )
+{
+	const double dx = bx - ax, dy = by - ay, dz = bz - az;
+	const double d2 = dx * dx + dy * dy + dz * dz;
+
+	if( d2 == 0 ) {
+		scalar::segment_distances( x, y, z, n, ax, ay, az, bx, by, bz, dist );
+		return;
+	}
+
+	const __m128d vax = _mm_set1_pd( ax ), vay = _mm_set1_pd( ay ), vaz = _mm_set1_pd( az );
+	const __m128d vdx = _mm_set1_pd( dx ), vdy = _mm_set1_pd( dy ), vdz = _mm_set1_pd( dz );
+	const __m128d vd2 = _mm_set1_pd( d2 );
+	const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd( 1.0 );
+	size_t i = 0;
+	for( ; i + 2 <= n; i += 2 ) {
+		const __m128d px = _mm_sub_pd( _mm_loadu_pd( x + i ), vax );
+		const __m128d py = _mm_sub_pd( _mm_loadu_pd( y + i ), vay );
+		const __m128d pz = _mm_sub_pd( _mm_loadu_pd( z + i ), vaz );
+		__m128d t = _mm_add_pd( _mm_add_pd( _mm_mul_pd( vdx, px ), _mm_mul_pd( vdy, py ) ),
+					_mm_mul_pd( vdz, pz ) );
+		t = _mm_div_pd( t, vd2 );
+		t = _mm_max_pd( zero, t );	// t < 0 ? 0 : t
+		t = _mm_min_pd( one, t );	// t > 1 ? 1 : t
+		const __m128d ex = _mm_sub_pd( px, _mm_mul_pd( t, vdx ) );
+		const __m128d ey = _mm_sub_pd( py, _mm_mul_pd( t, vdy ) );
+		const __m128d ez = _mm_sub_pd( pz, _mm_mul_pd( t, vdz ) );
+		_mm_storeu_pd( dist + i, _mm_sqrt_pd( _mm_add_pd( _mm_add_pd( _mm_mul_pd( ex, ex ),
+									      _mm_mul_pd( ey, ey ) ),
+								  _mm_mul_pd( ez, ez ) ) ) );
+	}
+	scalar::segment_distances( x + i, y + i, z + i, n - i, ax, ay, az, bx, by, bz, dist + i );
+}
+
+template <>
+void circumradii<double>( const double* u, const double* v, size_t n,
+			  double u1, double v1, double u3, double v3, double* radius )
+{
+	const double x31 = u3 - u1, y31 = v3 - v1;
+	const __m128d chord = _mm_set1_pd( std::sqrt( x31 * x31 + y31 * y31 ) );
+	const __m128d collinear = _mm_set1_pd( std::numeric_limits<double>::epsilon() );
+	const __m128d none = _mm_set1_pd( std::numeric_limits<double>::max() );
+	const __m128d two = _mm_set1_pd( 2.0 ), sign = _mm_set1_pd( -0.0 );
+	const __m128d vu1 = _mm_set1_pd( u1 ), vv1 = _mm_set1_pd( v1 );
+	const __m128d vu3 = _mm_set1_pd( u3 ), vv3 = _mm_set1_pd( v3 );
+	size_t i = 0;
+	for( ; i + 2 <= n; i += 2 ) {
+		const __m128d pu = _mm_loadu_pd( u + i ), pv = _mm_loadu_pd( v + i );
+		const __m128d x12 = _mm_sub_pd( vu1, pu ), y12 = _mm_sub_pd( vv1, pv );
+		const __m128d x23 = _mm_sub_pd( pu, vu3 ), y23 = _mm_sub_pd( pv, vv3 );
+		const __m128d a = _mm_sqrt_pd( _mm_add_pd( _mm_mul_pd( x12, x12 ), _mm_mul_pd( y12, y12 ) ) );
+		const __m128d b = _mm_sqrt_pd( _mm_add_pd( _mm_mul_pd( x23, x23 ), _mm_mul_pd( y23, y23 ) ) );
+		const __m128d den = _mm_andnot_pd( sign, _mm_sub_pd( _mm_mul_pd( x12, y23 ),
+								     _mm_mul_pd( x23, y12 ) ) );
+		const __m128d ab = _mm_mul_pd( a, b );
+		const __m128d r = _mm_div_pd( _mm_div_pd( _mm_mul_pd( ab, chord ), two ), den );
+		const __m128d arc = _mm_cmpgt_pd( den, _mm_mul_pd( _mm_mul_pd( collinear, a ), b ) );
+		_mm_storeu_pd( radius + i, _mm_or_pd( _mm_and_pd( arc, r ), _mm_andnot_pd( arc, none ) ) );
+	}
+	scalar::circumradii( u + i, v + i, n - i, u1, v1, u3, v3, radius + i );
+}
+
+template <>
+double max_arc_distance<double>( const double* u, const double* v, size_t n,
+				 double cu, double cv, double r )
+{
+	const __m128d vcu = _mm_set1_pd( cu ), vcv = _mm_set1_pd( cv ), vr = _mm_set1_pd( r );
+	const __m128d sign = _mm_set1_pd( -0.0 );
+	__m128d worst = _mm_setzero_pd();
+	size_t i = 0;
+	for( ; i + 2 <= n; i += 2 ) {
+		const __m128d du = _mm_sub_pd( vcu, _mm_loadu_pd( u + i ) );
+		const __m128d dv = _mm_sub_pd( vcv, _mm_loadu_pd( v + i ) );
+		const __m128d d = _mm_andnot_pd( sign, _mm_sub_pd( _mm_sqrt_pd( _mm_add_pd( _mm_mul_pd( du, du ),
+											     _mm_mul_pd( dv, dv ) ) ),
+								   vr ) );
+		worst = _mm_max_pd( d, worst );	// d > worst ? d : worst
+	}
+
+	double lanes[2];
+	_mm_storeu_pd( lanes, worst );
+	double rest = scalar::max_arc_distance( u + i, v + i, n - i, cu, cv, r );
+	return std::max( std::max( lanes[0], lanes[1] ), rest );
+}
+
+}
+
+#endif // GEOMETRY_SSE2
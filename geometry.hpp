@@ -0,0 +1,143 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+
+/*! Span kernels for the line and arc fitting of the Gcode smoother.
+ *  Each evaluates n consecutive points given as separate coordinate
+ *  arrays, and they are templated on the precision (float or double).
+ *  The compiler doesn't vectorise the square roots on its own (they may
+ *  set errno), so double has SSE2 versions where the processor has it;
+ *  they give the same results as the plain ones.
+ */
+
+#if defined(__SSE2__)
+#define GEOMETRY_SSE2
+#endif
+
+namespace geometry
+{
+	namespace scalar
+	{
+		template <typename T>
+		void segment_distances( const T* x, const T* y, const T* z, size_t n,
+					T ax, T ay, T az, T bx, T by, T bz, T* dist )
+		{
+			const T dx = bx - ax, dy = by - ay, dz = bz - az;
+			const T d2 = dx * dx + dy * dy + dz * dz;
+
+			if( d2 == 0 ) {
+				for( size_t i = 0; i < n; i++ )
+					dist[i] = 0;
+				return;
+			}
+
+			for( size_t i = 0; i < n; i++ ) {
+				T t = ( dx * (x[i] - ax) + dy * (y[i] - ay) + dz * (z[i] - az) ) / d2;
+				t = t < 0 ? 0 : t;
+				t = t > 1 ? 1 : t;
+				const T ex = x[i] - ax - t * dx;
+				const T ey = y[i] - ay - t * dy;
+				const T ez = z[i] - az - t * dz;
+				dist[i] = std::sqrt( ex * ex + ey * ey + ez * ez );
+			}
+		}
+
+		template <typename T>
+		void circumradii( const T* u, const T* v, size_t n,
+				  T u1, T v1, T u3, T v3, T* radius )
+		{
+			const T x31 = u3 - u1, y31 = v3 - v1;
+			const T chord = std::sqrt( x31 * x31 + y31 * y31 );
+			const T collinear = std::numeric_limits<T>::epsilon();
+			const T none = std::numeric_limits<T>::max();
+
+			for( size_t i = 0; i < n; i++ ) {
+				const T x12 = u1 - u[i], y12 = v1 - v[i];
+				const T x23 = u[i] - u3, y23 = v[i] - v3;
+				const T a = std::sqrt( x12 * x12 + y12 * y12 );
+				const T b = std::sqrt( x23 * x23 + y23 * y23 );
+				const T den = std::fabs( x12 * y23 - x23 * y12 );
+				radius[i] = den > collinear * a * b ? a * b * chord / 2 / den : none;
+			}
+		}
+
+		template <typename T>
+		T max_arc_distance( const T* u, const T* v, size_t n, T cu, T cv, T r )
+		{
+			T worst = 0;
+			for( size_t i = 0; i < n; i++ ) {
+				const T du = cu - u[i], dv = cv - v[i];
+				const T d = std::fabs( std::sqrt( du * du + dv * dv ) - r );
+				worst = d > worst ? d : worst;
+			}
+			return worst;
+		}
+	}
+
+	//! distance of every point from the segment a..b
+	/*! The distances are all 0 if a and b are the same point.
+	 */
+	template <typename T>
+	inline void segment_distances( const T* x, const T* y, const T* z, size_t n,
+				       T ax, T ay, T az, T bx, T by, T bz, T* dist )
+	{
+		scalar::segment_distances( x, y, z, n, ax, ay, az, bx, by, bz, dist );
+	}
+
+	//! radius of the circle through 1, every point and 3, in the (u, v) plane
+	/*! The radius is the largest T if the three points are collinear, which
+	 *  is judged by the angle at the point rather than by the area of the
+	 *  triangle, so that small steps on a large board still make arcs.
+	 */
+	template <typename T>
+	inline void circumradii( const T* u, const T* v, size_t n,
+				 T u1, T v1, T u3, T v3, T* radius )
+	{
+		scalar::circumradii( u, v, n, u1, v1, u3, v3, radius );
+	}
+
+	//! largest distance of the points from the circle around (cu, cv)
+	template <typename T>
+	inline T max_arc_distance( const T* u, const T* v, size_t n, T cu, T cv, T r )
+	{
+		return scalar::max_arc_distance( u, v, n, cu, cv, r );
+	}
+
+#ifdef GEOMETRY_SSE2
+	template <>
+	void segment_distances<double>( const double* x, const double* y, const double* z, size_t n,
+					double ax, double ay, double az, double bx, double by, double bz,
+					double* dist );
+	template <>
+	void circumradii<double>( const double* u, const double* v, size_t n,
+				  double u1, double v1, double u3, double v3, double* radius );
+	template <>
+	double max_arc_distance<double>( const double* u, const double* v, size_t n,
+					 double cu, double cv, double r );
+#endif
+}
+
+#endif // GEOMETRY_H
@@ -19,10 +19,18 @@
  */
 
 #include "gerberimporter.hpp"
+#include "hash.hpp"
 #include <boost/scoped_array.hpp>
 
+#include <algorithm>
+#include <cmath>
+
+boost::mutex gerbv_mutex;
+
 GerberImporter::GerberImporter(const string path)
 {
+    boost::mutex::scoped_lock lock( gerbv_mutex );
+
     project = gerbv_create_project();
 
     const char* cfilename = path.c_str();
@@ -32,6 +40,14 @@ GerberImporter::GerberImporter(const string path)
     gerbv_open_layer_from_filename(project, filename.get());
     if( project->file[0] == NULL)
         throw gerber_exception();
+
+    fingerprint = Hash().add_file(path).hex();
+}
+
+string
+GerberImporter::get_fingerprint()
+{
+    return fingerprint;
 }
 
 gdouble
@@ -89,6 +105,285 @@ GerberImporter::get_max_y()
     return project->file[0]->image->info->max_y;
 }
 
+gdouble
+GerberImporter::get_min_feature_size()
+{
+    if(!project || !project->file[0])
+        throw gerber_exception();
+
+    gerbv_image_t* image = project->file[0]->image;
+    gdouble min_size = 0;
+
+    for( int i = 0; i < APERTURE_MAX; i++ ) {
+        gerbv_aperture_t* aperture = image->aperture[i];
+        if( !aperture )
+            continue;
+
+        gdouble size;
+        switch( aperture->type ) {
+        case GERBV_APTYPE_CIRCLE:
+            size = aperture->parameter[0];
+            break;
+        case GERBV_APTYPE_RECTANGLE:
+        case GERBV_APTYPE_OVAL:
+            size = std::min( aperture->parameter[0], aperture->parameter[1] );
+            break;
+        case GERBV_APTYPE_POLYGON:
+            // diameter of the inscribed circle
+            size = aperture->parameter[0] * cos( M_PI / std::max( aperture->parameter[1], 3.0 ) );
+            break;
+        default:
+            // macros and the like can't be measured easily
+            continue;
+        }
+
+        // zero-sized apertures are used for region fills
+        if( size > 0 && ( min_size == 0 || size < min_size ) )
+            min_size = size;
+    }
+
+    return min_size;
+}
+
+//! width of the stroke an aperture draws, 0 for apertures we can't measure
+static gdouble aperture_width( gerbv_aperture_t* aperture )
+{
+    if( !aperture )
+        return 0;
+
+    switch( aperture->type ) {
+    case GERBV_APTYPE_CIRCLE:
+    case GERBV_APTYPE_POLYGON:
+        return aperture->parameter[0];
+    case GERBV_APTYPE_RECTANGLE:
+    case GERBV_APTYPE_OVAL:
+        return std::max( aperture->parameter[0], aperture->parameter[1] );
+    default:
+        return 0;
+    }
+}
+
+layer_statistics
+GerberImporter::get_statistics()
+{
+    if(!project || !project->file[0])
+        throw gerber_exception();
+
+    gerbv_image_t* image = project->file[0]->image;
+    layer_statistics stats;
+
+    // gerbv already counted the D03 flashes and D02 moves while parsing;
+    // every move starts a trace that may turn out as a separate component.
+    stats.flashes = image->gerbv_stats ? image->gerbv_stats->D3 : 0;
+    stats.strokes = image->gerbv_stats ? image->gerbv_stats->D2 : 0;
+    stats.outline_length = 0;
+
+    bool in_stroke = false;
+    for( gerbv_net_t* net = image->netlist; net; net = net->next ) {
+        if( net->aperture_state != GERBV_APERTURE_STATE_ON ) {
+            in_stroke = false;
+            if( net->aperture_state == GERBV_APERTURE_STATE_OFF )
+                continue;
+        }
+
+        gdouble width = ( net->aperture >= 0 && net->aperture < APERTURE_MAX ) ? aperture_width( image->aperture[net->aperture] ) : 0;
+
+        if( net->aperture_state == GERBV_APERTURE_STATE_FLASH ) {
+            stats.outline_length += M_PI * width;
+        } else {
+            // both sides of the trace, plus the round caps once per trace
+            stats.outline_length += 2 * hypot( net->stop_x - net->start_x, net->stop_y - net->start_y );
+            if( !in_stroke )
+                stats.outline_length += M_PI * width;
+            in_stroke = true;
+        }
+    }
+
+    return stats;
+}
+
+// maximum deviation of the polygons from arcs and circles in inches
+static const gdouble arc_tolerance = 0.0001;
+
+//! number of segments approximating a full circle of the given radius
+static int circle_segments( gdouble radius )
+{
+    if( radius <= arc_tolerance )
+        return 8;
+    return std::min( std::max( int( ceil( M_PI / acos( 1 - arc_tolerance / radius ) ) ), 8 ), 256 );
+}
+
+static void add_circle( icoords& points, gdouble x, gdouble y, gdouble radius )
+{
+    int segments = circle_segments(radius);
+    for( int i = 0; i < segments; i++ )
+        points.push_back( icoordpair( x + radius * cos( 2 * M_PI * i / segments ),
+                                      y + radius * sin( 2 * M_PI * i / segments ) ) );
+}
+
+static bool cross_ccw( const icoordpair& o, const icoordpair& a, const icoordpair& b )
+{
+    return ( a.first - o.first ) * ( b.second - o.second ) - ( a.second - o.second ) * ( b.first - o.first ) > 0;
+}
+
+//! convex hull of the given points, counterclockwise (Andrew's monotone chain)
+static icoords convex_hull( icoords points )
+{
+    std::sort( points.begin(), points.end() );
+    points.erase( std::unique( points.begin(), points.end() ), points.end() );
+    if( points.size() < 3 )
+        return points;
+
+    icoords hull( 2 * points.size() );
+    size_t k = 0;
+    for( size_t i = 0; i < points.size(); i++ ) {
+        while( k >= 2 && !cross_ccw( hull[k - 2], hull[k - 1], points[i] ) )
+            k--;
+        hull[k++] = points[i];
+    }
+    for( size_t i = points.size() - 1, lower = k + 1; i > 0; i-- ) {
+        while( k >= lower && !cross_ccw( hull[k - 2], hull[k - 1], points[i - 1] ) )
+            k--;
+        hull[k++] = points[i - 1];
+    }
+
+    hull.resize( k - 1 );
+    return hull;
+}
+
+/* Adds the outline of an aperture placed at x, y. All standard apertures
+ * are convex (holes are ignored), which allows building strokes from the
+ * hull of the start and end shapes.
+ */
+static bool add_aperture_shape( icoords& points, gerbv_aperture_t* aperture, gdouble x, gdouble y )
+{
+    if( !aperture )
+        return false;
+
+    const double* p = aperture->parameter;
+    switch( aperture->type ) {
+    case GERBV_APTYPE_CIRCLE:
+        add_circle( points, x, y, p[0] / 2 );
+        return true;
+    case GERBV_APTYPE_RECTANGLE:
+        points.push_back( icoordpair( x - p[0] / 2, y - p[1] / 2 ) );
+        points.push_back( icoordpair( x + p[0] / 2, y - p[1] / 2 ) );
+        points.push_back( icoordpair( x + p[0] / 2, y + p[1] / 2 ) );
+        points.push_back( icoordpair( x - p[0] / 2, y + p[1] / 2 ) );
+        return true;
+    case GERBV_APTYPE_OVAL: {
+        // two half circles along the longer side
+        gdouble radius = std::min( p[0], p[1] ) / 2;
+        gdouble dx = p[0] > p[1] ? p[0] / 2 - radius : 0;
+        gdouble dy = p[0] > p[1] ? 0 : p[1] / 2 - radius;
+        add_circle( points, x - dx, y - dy, radius );
+        add_circle( points, x + dx, y + dy, radius );
+        return true;
+    }
+    case GERBV_APTYPE_POLYGON: {
+        int corners = std::max( int(p[1]), 3 );
+        for( int i = 0; i < corners; i++ ) {
+            gdouble angle = p[2] * M_PI / 180 + 2 * M_PI * i / corners;
+            points.push_back( icoordpair( x + p[0] / 2 * cos(angle), y + p[0] / 2 * sin(angle) ) );
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+//! points along a circular net, excluding its start point
+static void add_arc_points( icoords& points, gerbv_cirseg_t* cirseg )
+{
+    gdouble radius = cirseg->width / 2;
+    gdouble sweep = ( cirseg->angle2 - cirseg->angle1 ) * M_PI / 180;
+    int segments = std::max( int( ceil( circle_segments(radius) * fabs(sweep) / ( 2 * M_PI ) ) ), 1 );
+
+    for( int i = 1; i <= segments; i++ ) {
+        gdouble angle = cirseg->angle1 * M_PI / 180 + sweep * i / segments;
+        points.push_back( icoordpair( cirseg->cp_x + radius * cos(angle),
+                                      cirseg->cp_y + cirseg->height / 2 * sin(angle) ) );
+    }
+}
+
+/* Converts flashes, strokes and regions to polygons. The polygons overlap
+ * freely; whoever uses them has to unite them.
+ */
+bool
+GerberImporter::get_polygons( std::vector<icoords>& polygons )
+{
+    if(!project || !project->file[0])
+        throw gerber_exception();
+
+    gerbv_image_t* image = project->file[0]->image;
+    bool in_region = false;
+    icoords region;
+
+    for( gerbv_net_t* net = image->netlist; net; net = net->next ) {
+        if( net->layer && ( net->layer->polarity == GERBV_POLARITY_CLEAR ||
+                            net->layer->stepAndRepeat.X > 1 || net->layer->stepAndRepeat.Y > 1 ) )
+            return false;
+
+        if( net->interpolation == GERBV_INTERPOLATION_PAREA_START ) {
+            in_region = true;
+            continue;
+        }
+        if( in_region ) {
+            // a move inside a region starts another contour
+            bool end = net->interpolation == GERBV_INTERPOLATION_PAREA_END;
+            if( end || net->aperture_state == GERBV_APERTURE_STATE_OFF ) {
+                if( region.size() >= 3 )
+                    polygons.push_back( region );
+                region.clear();
+                in_region = !end;
+                continue;
+            }
+
+            if( region.empty() )
+                region.push_back( icoordpair( net->start_x, net->start_y ) );
+            if( ( net->interpolation == GERBV_INTERPOLATION_CW_CIRCULAR ||
+                  net->interpolation == GERBV_INTERPOLATION_CCW_CIRCULAR ) && net->cirseg )
+                add_arc_points( region, net->cirseg );
+            else
+                region.push_back( icoordpair( net->stop_x, net->stop_y ) );
+            continue;
+        }
+
+        if( net->aperture_state == GERBV_APERTURE_STATE_OFF )
+            continue;
+        if( net->aperture < 0 || net->aperture >= APERTURE_MAX )
+            return false;
+        gerbv_aperture_t* aperture = image->aperture[net->aperture];
+
+        icoords points;
+        if( net->aperture_state == GERBV_APERTURE_STATE_FLASH ) {
+            if( !add_aperture_shape( points, aperture, net->stop_x, net->stop_y ) )
+                return false;
+            polygons.push_back( convex_hull(points) );
+            continue;
+        }
+
+        // a stroke, split into straight pieces
+        icoords path( 1, icoordpair( net->start_x, net->start_y ) );
+        if( ( net->interpolation == GERBV_INTERPOLATION_CW_CIRCULAR ||
+              net->interpolation == GERBV_INTERPOLATION_CCW_CIRCULAR ) && net->cirseg )
+            add_arc_points( path, net->cirseg );
+        else
+            path.push_back( icoordpair( net->stop_x, net->stop_y ) );
+
+        for( size_t i = 1; i < path.size(); i++ ) {
+            points.clear();
+            if( !add_aperture_shape( points, aperture, path[i - 1].first, path[i - 1].second ) ||
+                !add_aperture_shape( points, aperture, path[i].first, path[i].second ) )
+                return false;
+            polygons.push_back( convex_hull(points) );
+        }
+    }
+
+    return true;
+}
+
 #include <iostream>
 
 void
@@ -110,14 +405,29 @@ GerberImporter::render(Cairo::RefPtr<Cairo::ImageSurface> surface,
     project->file[0]->color = color_saturated_white;
 
     cairo_t* cr = cairo_create( surface->cobj() );
-    gerbv_render_layer_to_cairo_target( cr, project->file[0], &render_info );
+    {
+        boost::mutex::scoped_lock lock( gerbv_mutex );
+        gerbv_render_layer_to_cairo_target( cr, project->file[0], &render_info );
+    }
     
     cairo_destroy(cr);
 
     /// @todo check wheter importing was successful
 }
 
+void
+GerberImporter::render_bitmap(Cairo::RefPtr<Cairo::ImageSurface> surface,
+			      const guint dpi, const double min_x, const double min_y)
+	throw (import_exception)
+{
+    // GERBV_RENDER_TYPE_CAIRO_NORMAL draws without antialiasing, so every
+    // pixel is either fully covered or not at all, and an A1 target keeps
+    // exactly the pixels an ARGB32 target would turn white
+    render( surface, dpi, min_x, min_y );
+}
+
 GerberImporter::~GerberImporter()
 {
+    boost::mutex::scoped_lock lock( gerbv_mutex );
     gerbv_destroy_project(project);
 }
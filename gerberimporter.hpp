@@ -31,8 +31,13 @@ extern "C"
     #include <gerbv.h>
 }
 
+#include <boost/thread/mutex.hpp>
+
 struct gerber_exception : virtual import_exception {};
 
+//! libgerbv isn't thread-safe; every call into it has to hold this lock.
+extern boost::mutex gerbv_mutex;
+
 //! Importer for RS274-X Gerber files.
 
 /*! GerberImporter is using libgerbv and hence features
@@ -51,16 +56,24 @@ public:
     virtual gdouble get_max_x();
     virtual gdouble get_min_y();
     virtual gdouble get_max_y();
+    virtual gdouble get_min_feature_size();
+    virtual layer_statistics get_statistics();
+    virtual string get_fingerprint();
+    virtual bool get_polygons( std::vector<icoords>& polygons );
 
     virtual void render(Cairo::RefPtr<Cairo::ImageSurface> surface,
 			const guint dpi, const double min_x, const double min_y)
 	    throw (import_exception);
+    virtual void render_bitmap(Cairo::RefPtr<Cairo::ImageSurface> surface,
+			       const guint dpi, const double min_x, const double min_y)
+	    throw (import_exception);
 
     virtual ~GerberImporter();
 protected:
 private:
 
     gerbv_project_t* project;
+    string fingerprint;
 };
 
 #endif // GERBERIMPORTER_H
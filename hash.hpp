@@ -0,0 +1,70 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+using std::string;
+
+//! 64 bit FNV-1a hash, used to recognize unchanged input data.
+/*! Not cryptographically strong; whoever relies on it for identity has to
+ *  compare the hashed data (or a description of it) as well.
+ */
+class Hash
+{
+public:
+	Hash() : state( 14695981039346656037ULL ) {};
+
+	Hash& add( const char* data, size_t length ) {
+		for( size_t i = 0; i < length; i++ ) {
+			state ^= static_cast<unsigned char>( data[i] );
+			state *= 1099511628211ULL;
+		}
+		return *this;
+	};
+
+	Hash& add( const string& data ) { return add( data.data(), data.size() ); };
+
+	//! adds the contents of a file; a missing file adds nothing
+	Hash& add_file( const string& path ) {
+		std::ifstream in( path.c_str(), std::ios::binary );
+		char buffer[4096];
+		while( in.read( buffer, sizeof(buffer) ) || in.gcount() )
+			add( buffer, in.gcount() );
+		return *this;
+	};
+
+	uint64_t value() const { return state; };
+
+	//! the hash as 16 hex digits
+	string hex() const {
+		char digits[17];
+		snprintf( digits, sizeof(digits), "%016llx", static_cast<unsigned long long>( state ) );
+		return digits;
+	};
+
+private:
+	uint64_t state;
+};
+
+#endif // HASH_H
@@ -21,6 +21,8 @@
 #ifndef IMPORTER_H
 #define IMPORTER_H
 
+#include <string>
+
 #include <glibmm/ustring.h>
 using Glib::ustring;
 
@@ -28,10 +30,21 @@ using Glib::ustring;
 #include <cairomm/cairomm.h>
 #include <gdk/gdkcairo.h>
 
+#include <vector>
+
 #include <boost/exception/all.hpp>
+
+#include "coord.hpp"
 struct import_exception : virtual std::exception, virtual boost::exception {};
 typedef boost::error_info<struct tag_my_info, ustring> errorstring;
 
+//! rough figures about the contents of a layer, used for cost estimates.
+struct layer_statistics {
+	unsigned int flashes;	//!< number of flashed apertures (pads)
+	unsigned int strokes;	//!< number of separately started traces and regions
+	double outline_length;	//!< summed outline length of all primitives in inches
+};
+
 //! pure virtual base class for importers.
 class LayerImporter
 {
@@ -43,10 +56,32 @@ public:
 	virtual gdouble get_min_y() = 0;
 	virtual gdouble get_max_y() = 0;
 
+	//! size of the smallest aperture used in the layer, 0 if unknown
+	virtual gdouble get_min_feature_size() = 0;
+
+	virtual layer_statistics get_statistics() = 0;
+
+	//! digest of the imported data; equal digests mean unchanged input
+	virtual std::string get_fingerprint() = 0;
+
+	//! the dark areas of the layer as closed polygons, in inches
+	/*! returns false if the layer contains features that can't be
+	 *  converted, in which case it has to be rendered instead.
+	 */
+	virtual bool get_polygons( std::vector<icoords>& polygons ) = 0;
+
 	virtual void render(Cairo::RefPtr<Cairo::ImageSurface> surface,
 			    const guint dpi, const double xoff, const double yoff)
 		throw (import_exception) = 0;
-	
+
+	//! renders the dark areas as set bits into a Cairo::FORMAT_A1 surface
+	/*! Surface renders through this; the bitmap is a 32nd of the size of
+	 *  an ARGB32 rendering.
+	 */
+	virtual void render_bitmap(Cairo::RefPtr<Cairo::ImageSurface> surface,
+				   const guint dpi, const double xoff, const double yoff)
+		throw (import_exception) = 0;
+
 };
 
 #endif // IMPORTER_H
@@ -8,15 +8,33 @@ Layer::Layer( const string& name, shared_ptr<Surface> surface, shared_ptr<Routin
 	this->mirror_absolute = mirror_absolute;
 	this->surface = surface;
 	this->manufacturer = manufacturer;
+	this->traced = false;
 }
 
 #include <iostream>
+#include "log.hpp"
 using namespace std;
 
-vector< shared_ptr<icoords> >
+const ToolpathSet&
 Layer::get_toolpaths()
 {
-	return surface->get_toolpath( manufacturer, mirrored, mirror_absolute );
+	if( !traced ) {
+		if( engine )
+			engine->get_toolpath( manufacturer, mirrored, mirror_absolute, toolpaths );
+		else {
+			surface->get_toolpath( manufacturer, mirrored, mirror_absolute, toolpaths );
+
+			if( surface->get_blasts() )
+				LOG(LOG_INFO) << "Note: " << surface->get_blasts() << " stray pixel configuration(s) had to be "
+					      << "repaired while tracing the " << name << " layer." << endl;
+		}
+		traced = true;
+
+		if( cache )
+			cache->store( cache_key, toolpaths );
+	}
+
+	return toolpaths;
 }
 
 shared_ptr<RoutingMill>
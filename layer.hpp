@@ -12,13 +12,15 @@ using std::vector;
 #include "coord.hpp"
 #include "surface.hpp"
 #include "mill.hpp"
+#include "toolpath_cache.hpp"
+#include "polygon_engine.hpp"
 
 class Layer : boost::noncopyable
 {
 public:
 	Layer( const string& name, shared_ptr<Surface> surface, shared_ptr<RoutingMill> manufacturer, bool backside, bool mirror_absolute );
 	
-	vector< shared_ptr<icoords> > get_toolpaths();
+	const ToolpathSet& get_toolpaths();
 	shared_ptr<RoutingMill> get_manufacturer();
 	string get_name() { return name; };
 	void add_mask( shared_ptr<Layer>);
@@ -29,6 +31,13 @@ private:
 	bool mirror_absolute;
 	shared_ptr<Surface> surface;
 	shared_ptr<RoutingMill>    manufacturer;
+	shared_ptr<PolygonEngine>  engine;	// used instead of the surface if set
+
+	// the toolpaths are calculated once, or taken from the cache
+	bool traced;
+	ToolpathSet toolpaths;
+	shared_ptr<ToolpathCache> cache;
+	string cache_key;
 
 	friend class Board;
 };
@@ -0,0 +1,42 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log.hpp"
+
+#include <iostream>
+
+#include <boost/thread/tss.hpp>
+
+// the streams aren't owned by the threads
+static void keep_stream( std::ostream* )
+{
+}
+
+static boost::thread_specific_ptr<std::ostream> thread_stream( keep_stream );
+
+std::ostream& Log::stream()
+{
+	std::ostream* out = thread_stream.get();
+	return out ? *out : std::cerr;
+}
+
+void Log::set_stream( std::ostream* out )
+{
+	thread_stream.reset( out );
+}
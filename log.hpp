@@ -0,0 +1,58 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <ostream>
+
+enum log_level {
+	LOG_ERROR,
+	LOG_WARNING,
+	LOG_INFO,	//!< progress messages
+	LOG_DEBUG	//!< diagnostics of the algorithms, compiled out by default
+};
+
+// messages above this level are compiled out. configure --enable-debug-log
+// raises it to LOG_DEBUG.
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_INFO
+#endif
+
+//! Where the log messages of the current thread go.
+/*! The messages go to std::cerr unless the thread set another stream, as
+ *  the batch processor does to collect the messages of each job.
+ */
+class Log
+{
+public:
+	static std::ostream& stream();
+
+	//! sets the stream for the current thread, NULL for std::cerr
+	static void set_stream( std::ostream* out );
+};
+
+//! LOG(LOG_INFO) << "message" << endl;
+/*! The condition is a constant, so messages above LOG_MAX_LEVEL, including
+ *  the evaluation of their arguments, are removed by the compiler.
+ */
+#define LOG(level) \
+	if( (level) > LOG_MAX_LEVEL ) {} else Log::stream()
+
+#endif // LOG_H
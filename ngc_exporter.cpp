@@ -18,6 +18,9 @@
  */
 
 #include "ngc_exporter.hpp"
+#include "export_pipeline.hpp"
+#include "output_file.hpp"
+#include "log.hpp"
 
 #include <boost/foreach.hpp>
 
@@ -40,6 +43,13 @@ NGC_Exporter::set_svg_exporter( shared_ptr<SVG_Exporter> svgexpo )
 }
 
 
+void
+NGC_Exporter::set_feed_planner( shared_ptr<FeedPlanner> planner )
+{
+	this->planner = planner;
+}
+
+
 void
 NGC_Exporter::add_header( string header )
 {
@@ -53,7 +63,7 @@ NGC_Exporter::export_all(boost::program_options::variables_map& options)
 		std::stringstream option_name;
 		option_name << layername << "-output";
 		string of_name = options[option_name.str()].as<string>();
-		cerr << "Current Layer: " << layername << ", exporting to " << of_name << "." << endl;
+		LOG(LOG_INFO) << "Current Layer: " << layername << ", exporting to " << of_name << "." << endl;
 		export_layer( board->get_layer(layername), of_name);
 	}
 }
@@ -65,17 +75,42 @@ NGC_Exporter::get_tolerance( void )
 	return 5.0/this->board->get_dpi();
 }
 
-void
-NGC_Exporter::export_layer( shared_ptr<Layer> layer, string of_name )
+//! writes the toolpaths as they are, one complete line per point
+class NGC_Sink
 {
-	string layername = layer->get_name();
-	shared_ptr<RoutingMill> mill = layer->get_manufacturer();
+public:
+	NGC_Sink( std::ostream& of, shared_ptr<RoutingMill> mill ) : of(of), mill(mill) {}
 
-	bool bSvgOnce = TRUE;
-	
-	// open output file
-	std::ofstream of; of.open( of_name.c_str() );
+	void begin_contour( double x, double y )
+	{
+		// retract, move to the starting point of the next contour
+		of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
+		of << "G00 Z" << CONVERT_UNITS(mill->zsafe) << " ( retract )\n" << endl;
+		of << "G00 X" << CONVERT_UNITS(x) << " Y" << CONVERT_UNITS(y) << " ( rapid move to begin. )\n";
+	}
+
+	void begin_pass( double z )
+	{
+		of << "G01 Z" << CONVERT_UNITS(z) << " F" << CONVERT_UNITS(mill->feed) << " ( plunge. )\n";
+		of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
+	}
+
+	void point( double x, double y )
+	{
+		of << "G01 X" << CONVERT_UNITS(x) << " Y" << CONVERT_UNITS(y) << " F" << CONVERT_UNITS(mill->feed) << endl;
+	}
+
+	void end_pass() {}
+	void end_contour() {}
+
+private:
+	std::ostream& of;
+	shared_ptr<RoutingMill> mill;
+};
 
+void
+NGC_Exporter::write_header( std::ostream& of )
+{
 	// write header to .ngc file
         BOOST_FOREACH( string s, header )
         {
@@ -86,6 +121,17 @@ NGC_Exporter::export_layer( shared_ptr<Layer> layer, string of_name )
         of.setf( ios_base::fixed );
         of.precision(5);
 	of << setw(7);
+}
+
+void
+NGC_Exporter::export_layer( shared_ptr<Layer> layer, string of_name )
+{
+	shared_ptr<RoutingMill> mill = layer->get_manufacturer();
+
+	// open output file
+	OutputFile of( of_name );
+
+	write_header( of );
 
 	// preamble
 	of << ""
@@ -102,114 +148,19 @@ NGC_Exporter::export_layer( shared_ptr<Layer> layer, string of_name )
 	of << "G64 P" << get_tolerance() << " ( set maximum deviation from commanded toolpath )\n"
 	   << endl;
 
-	
 	//SVG EXPORTER
 	if (bDoSVG) {
 		//choose a color
 		svgexpo->set_rand_color();
 	}
-	
-	
+
 	// contours
-    cout << "exporting_layer";
- 	BOOST_FOREACH( shared_ptr<icoords> path, layer->get_toolpaths() )
-        {
-		// retract, move to the starting point of the next contour
-		of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-        of << "G00 Z" << CONVERT_UNITS(mill->zsafe) << " ( retract )\n" << endl;
-                of << "G00 X" << CONVERT_UNITS(path->begin()->first) << " Y" << CONVERT_UNITS(path->begin()->second) << " ( rapid move to begin. )\n";
-		
-			
-		//SVG EXPORTER
-		if (bDoSVG) {						
-			svgexpo->move_to(path->begin()->first, path->begin()->second);
-			bSvgOnce = TRUE;
-		}
-			
-		/** if we're cutting, perhaps do it in multiple steps, but do isolations just once.
-		 *  i know this is partially repetitive, but this way it's easier to read
-		 */
-		shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>( mill );
-		if( cutter && cutter->do_steps ) {
-			// cutting
-			double z_step = cutter->stepsize;
-			double z = mill->zwork + z_step * abs( int( mill->zwork / z_step ) );
-
-			while( z >= mill->zwork ) {
-				of << "G01 Z" << CONVERT_UNITS(z) << " F" << CONVERT_UNITS(mill->feed) << " ( plunge. )\n";
-				of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-
-				icoords::iterator iter = path->begin();
-				icoords::iterator last = path->end(); // initializing to quick & dirty sentinel value
-				icoords::iterator peek;
-				while( iter != path->end() ) {
-					peek = iter + 1;
-					if( /* it's necessary to write the coordinates if... */
-							last == path->end() || /* it's the beginning */
-							peek == path->end() || /* it's the end */
-							!( /* or if neither of the axis align */
-								( last->first == iter->first && iter->first == peek->first ) || /* x axis aligns */
-								( last->second == iter->second && iter->second == peek->second ) /* y axis aligns */
-							)
-							/* no need to check for "they are on one axis but iter is outside of last and peek" becaus that's impossible from how they are generated */
-					  ) {
-						of << "G01 X" << CONVERT_UNITS(iter->first) << " Y" << CONVERT_UNITS(iter->second) << " F" << CONVERT_UNITS(mill->feed) << endl;
-						
-						//SVG EXPORTER
-						if (bDoSVG) {
-							if (bSvgOnce) svgexpo->line_to(iter->first, iter->second);
-						}
-					}
-					last = iter;
-					++iter;
-				}
-				//SVG EXPORTER
-				if (bDoSVG) {
-					svgexpo->close_path();
-					bSvgOnce = FALSE;
-				}
-			
-				z -= z_step;
-			}
-		} else {
-			// isolating
-			of << "G01 Z" << CONVERT_UNITS(mill->zwork) << " F" << CONVERT_UNITS(mill->feed) << " ( plunge. )\n";
-			of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-
-			icoords::iterator iter = path->begin();
-			icoords::iterator last = path->end(); // initializing to quick & dirty sentinel value
-			icoords::iterator peek;
-			while( iter != path->end() ) {
-				peek = iter + 1;
-				if( /* it's necessary to write the coordinates if... */
-						last == path->end() || /* it's the beginning */
-						peek == path->end() || /* it's the end */
-						!( /* or if neither of the axis align */
-							( last->first == iter->first && iter->first == peek->first ) || /* x axis aligns */
-							( last->second == iter->second && iter->second == peek->second ) /* y axis aligns */
-						)
-						/* no need to check for "they are on one axis but iter is outside of last and peek" becaus that's impossible from how they are generated */
-				  ) {
-					of << "G01 X" << CONVERT_UNITS(iter->first) << " Y" << CONVERT_UNITS(iter->second) << " F" << CONVERT_UNITS(mill->feed) << endl;
-					
-					//SVG EXPORTER
-					if (bDoSVG) if (bSvgOnce) svgexpo->line_to(iter->first, iter->second);
-
-				}
-				last = iter;
-				++iter;
-			}
-			//SVG EXPORTER
-			if (bDoSVG) {
-				svgexpo->close_path();
-				bSvgOnce = FALSE;
-			}
-
-		}
-
-
-		
-        }
+	LOG(LOG_DEBUG) << "exporting " << layer->get_toolpaths().size() << " contours" << endl;
+	if( planner )
+		planner->begin_output( layer->get_name() );
+	NGC_Sink sink( of, mill );
+	pipeline::export_toolpaths( layer->get_toolpaths(), mill,
+				    bDoSVG ? svgexpo : shared_ptr<SVG_Exporter>(), planner, sink );
 
         of << endl;
 
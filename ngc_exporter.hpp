@@ -39,6 +39,7 @@ using boost::shared_ptr;
 #include "coord.hpp"
 #include "mill.hpp"
 #include "exporter.hpp"
+#include "feed_planner.hpp"
 #include "svg_exporter.hpp"
 
 class NGC_Exporter : public Exporter
@@ -54,17 +55,23 @@ public:
 
 	//SVG EXPORTER
 	void set_svg_exporter( shared_ptr<SVG_Exporter> svgexpo );
+
+	//! merges the segments of the cutting passes, see FeedPlanner
+	void set_feed_planner( shared_ptr<FeedPlanner> planner );
 	
 	void set_preamble(string);
 	void set_postamble(string);
 
 protected:
 	double get_tolerance( void );
+	void write_header( std::ostream& of );
 	virtual void export_layer( shared_ptr<Layer> layer, string of_name );
 
 	//SVG EXPORTER
 	bool bDoSVG;
 	shared_ptr<SVG_Exporter> svgexpo;
+
+	shared_ptr<FeedPlanner> planner;
 	
 	shared_ptr<Board> board;
 	vector<string> header;
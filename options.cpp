@@ -20,6 +20,8 @@
 
 #include "options.hpp"
 #include "config.h"
+#include "output_file.hpp"
+#include "log.hpp"
 
 #include <fstream>
 #include <list>
@@ -63,31 +65,94 @@ options::parse( int argc, char** argv )
 
 	parse_files();
 
-	/*
-	 * this needs to be an extra step, as --basename modifies the default
-	 * values of the --...-output parameters
-	 */
+	store_output_defaults( instance().vm, generic, style );
+}
+
+/*
+ * this needs to be an extra step, as --basename modifies the default
+ * values of the --...-output parameters
+ */
+void
+options::store_output_defaults( po::variables_map& vm, po::options_description const& generic, int style )
+{
 	string basename="";
-	if( instance().vm.count("basename"))
+	if( vm.count("basename"))
 	{
-		basename = instance().vm["basename"].as<string>()+"_";
+		basename = vm["basename"].as<string>()+"_";
 	}
 
 	string front_output="--front-output="+basename+"front.ngc";
 	string back_output="--back-output="+basename+"back.ngc";
 	string outline_output="--outline-output="+basename+"outline.ngc";
 	string drill_output="--drill-output="+basename+"drill.ngc";
+	string estimate_output="--estimate-output="+basename+"estimate.json";
+	string deps_output="--deps-output="+basename+"pcb2gcode.deps";
+	string statistics_output="--statistics-output="+basename+"statistics.json";
 
 	const char *fake_basename_command_line[] = {
 		"",
 		front_output.c_str(),
 		back_output.c_str(),
 		outline_output.c_str(),
-		drill_output.c_str()
+		drill_output.c_str(),
+		estimate_output.c_str(),
+		deps_output.c_str(),
+		statistics_output.c_str()
 	};
 
-	po::store(po::parse_command_line(5, (char**)fake_basename_command_line, generic, style), instance().vm);
-	po::notify(instance().vm);
+	po::store(po::parse_command_line(8, (char**)fake_basename_command_line, generic, style), vm);
+	po::notify(vm);
+}
+
+// options naming files, which are relative to the job directory in batch mode
+static const char* path_options[] = {
+	"front", "back", "outline", "drill", "svg", "preview", "binary", "preamble", "postamble",
+	"front-output", "back-output", "outline-output", "drill-output",
+	"estimate-output", "deps-output", "statistics-output"
+};
+
+/*
+ * Builds the options of a single batch job. Options given in the manifest
+ * take precedence over the job directory's millproject file, which in turn
+ * takes precedence over everything given to the batch process itself.
+ */
+void
+options::parse_job( const string& dir, const vector<string>& args, po::variables_map& vm )
+{
+	int style = po::command_line_style::default_style & ~po::command_line_style::allow_guessing;
+
+	po::options_description generic;
+	generic.add(instance().cli_options).add(instance().cfg_options);
+
+	po::store( po::command_line_parser(args).options(generic).style(style).run(), vm );
+
+	string file = dir + "/millproject";
+	std::ifstream stream( file.c_str() );
+	if( stream.good() )
+		po::store( po::parse_config_file( stream, instance().cfg_options ), vm );
+
+	// layer the batch process' own options below the job's options. the
+	// output file names are derived from each job's basename instead.
+	std::map<string, po::variable_value>& job_values = vm;
+	BOOST_FOREACH( const po::variables_map::value_type& option, instance().vm ) {
+		const string& name = option.first;
+		if( name.size() > 7 && name.compare( name.size() - 7, 7, "-output" ) == 0 )
+			continue;
+		if( name == "batch" || name == "jobs" )
+			continue;
+		if( !vm.count(name) || ( vm[name].defaulted() && !option.second.defaulted() ) )
+			job_values[name] = option.second;
+	}
+
+	store_output_defaults( vm, generic, style );
+
+	BOOST_FOREACH( const char* name, path_options ) {
+		if( vm.count(name) ) {
+			string path = vm[name].as<string>();
+			if( !path.empty() && path[0] != '/' )
+				job_values[name] = po::variable_value( boost::any( dir + "/" + path ), vm[name].defaulted() );
+		}
+	}
 }
 
 string
@@ -128,6 +193,10 @@ options::options() : cli_options("command line only options"),
 	cli_options.add_options()
 		("help,?",   "produce help message")
 		("version",  "\n")
+		("batch", po::value<string>(), "process all jobs listed in the given manifest file, see the manual")
+		("jobs", po::value<int>(), "number of boards processed in parallel in --batch mode; defaults to the number of cores")
+		("estimate", "only predict memory usage, work and output size, then exit")
+		("estimate-output", po::value<string>()->default_value("estimate.json"), "output file for the --estimate figures in JSON format\n")
 		;
 
 	cfg_options.add_options()
@@ -136,7 +205,16 @@ options::options() : cli_options("command line only options"),
 		("outline",  po::value<string>(), "pcb outline polygon RS274-X .gbr")
 		("drill", po::value<string>(), "Excellon drill file\n")
 
-		("svg", po::value<string>(), "SVG output file. EXPERIMENTAL\n")
+		("svg", po::value<string>(), "SVG output file. EXPERIMENTAL")
+		("binary", po::value<string>(), "binary file with the toolpaths of all layers and the drill holes, for other programs")
+		("preview", po::value<string>(), "PNG file with a picture of the final toolpaths and drill holes")
+		("preview-width", po::value<int>()->default_value(2000), "size of the longer side of the --preview in pixels")
+		("statistics", po::value<bool>()->zero_tokens(), "print the path lengths, plunges, tool changes and estimated machine time of the outputs")
+		("statistics-output", po::value<string>()->default_value("statistics.json"), "output file for the --statistics in JSON format")
+		("rapid-feed", po::value<double>()->default_value(100), "speed of rapid moves for --statistics in ipm (mm/min with --metric)")
+		("acceleration", po::value<double>()->default_value(10), "acceleration of the machine for --statistics and --feed-planning in inches/s^2 (mm/s^2 with --metric); 0 ignores it")
+		("feed-planning", po::value<bool>()->zero_tokens(), "merge the short segments of the milling paths so that controllers with look-ahead can run them near full feed, and print the expected speedup")
+		("junction-deviation", po::value<double>()->default_value(0.001), "how far --feed-planning lets the path deviate at merged segments and corners in inches (mm with --metric)\n")
 	
 		("zwork",    po::value<double>(), "milling depth in inches (Z-coordinate while engraving)")
 		("zsafe",      po::value<double>(), "safety height (Z-coordinate during rapid moves)")
@@ -144,7 +222,9 @@ options::options() : cli_options("command line only options"),
 		("mill-feed", po::value<double>(), "feed while isolating in ipm")
 		("mill-speed", po::value<int>(), "spindle rpm when milling")
 		("milldrill",   "drill using the mill head")
-		("extra-passes", po::value<int>(), "specify the the number of extra isolation passes, increasing the isolation width half the tool diameter with each pass\n")
+		("extra-passes", po::value<int>(), "specify the the number of extra isolation passes, increasing the isolation width half the tool diameter with each pass")
+		("front-engine", po::value<string>()->default_value("raster"), "how the front side isolation is calculated: raster (photoplot) or polygon")
+		("back-engine",  po::value<string>()->default_value("raster"), "how the back side isolation is calculated: raster (photoplot) or polygon\n")
 
 		("fill-outline", po::value<bool>()->zero_tokens(), "accept a contour instead of a polygon as outline")
 		("outline-width", po::value<double>(), "width of the outline")
@@ -163,8 +243,16 @@ options::options() : cli_options("command line only options"),
 		("smooth",   po::value<bool>()->zero_tokens(), "Apply a variant of Douglas-Peucker smoothing algorithm to the output.  Works best at higher (>1000) dpi.")
 		("metric",   "use metric units for parameters. does not affect gcode output")
 		("dpi",      po::value<int>()->default_value(1000),   "virtual photoplot resolution")
+		("auto-dpi", po::value<bool>()->zero_tokens(), "choose the resolution from the smallest aperture size instead of using --dpi")
+		("memory-budget", po::value<double>()->default_value(1024), "maximum memory in MiB used for the photoplots when using --auto-dpi")
+		("marching-squares", po::value<bool>()->zero_tokens(), "trace the photoplots along the pixel borders with cut corners, giving smoother paths with fewer points; the isolation is grown by one more pixel for it, so the clearance is never smaller than without")
 		("mirror-absolute",      po::value<bool>()->zero_tokens(),   "mirror back side along absolute zero instead of board center\n")
 
+		("cache-dir",     po::value<string>(), "directory in which toolpaths are kept for later runs with unchanged layers")
+		("cache-size",    po::value<double>()->default_value(256), "maximum size of the --cache-dir in MiB; least recently used toolpaths are removed first")
+		("incremental",   po::value<bool>()->zero_tokens(), "only regenerate output files whose inputs or options changed since the last run")
+		("deps-output",   po::value<string>()->default_value("pcb2gcode.deps"), "file recording the inputs of every output file for --incremental\n")
+
 		("basename",      po::value<string>(), "prefix for default output file names")
 		("front-output", po::value<string>()->default_value("front.ngc"), "output file for front layer")
 		("back-output", po::value<string>()->default_value("back.ngc"), "output file for back layer")
@@ -177,19 +265,58 @@ options::options() : cli_options("command line only options"),
 }
 
 
+static void check_batch_parameters( po::variables_map const& vm )
+{
+	if( vm.count("jobs") && vm["jobs"].as<int>() < 1 ) {
+		throw parameter_error( "Error: --jobs has to be at least 1.\n", 37 );
+	}
+}
+
 static void check_generic_parameters( po::variables_map const& vm )
 {
 	int dpi = vm["dpi"].as<int>();
-	if( dpi < 100 ) cerr << "Warning: very low DPI value." << endl;
-	if( dpi > 10000 ) cerr << "Warning: very high DPI value, processing may take extremely long" << endl;
+	if( dpi < 100 ) LOG(LOG_WARNING) << "Warning: very low DPI value." << endl;
+	if( dpi > 10000 ) LOG(LOG_WARNING) << "Warning: very high DPI value, processing may take extremely long" << endl;
+
+	if( vm.count("auto-dpi") && vm["memory-budget"].as<double>() <= 0 ) {
+		throw parameter_error( "Error: --memory-budget has to be greater than zero.\n", 28 );
+	}
+
+	if( vm.count("cache-dir") && vm["cache-size"].as<double>() <= 0 ) {
+		throw parameter_error( "Error: --cache-size has to be greater than zero.\n", 29 );
+	}
+
+	if( vm.count("preview") && vm["preview-width"].as<int>() <= 0 ) {
+		throw parameter_error( "Error: --preview-width has to be greater than zero.\n", 31 );
+	}
+
+	if( vm.count("statistics") && vm["rapid-feed"].as<double>() <= 0 ) {
+		throw parameter_error( "Error: --rapid-feed has to be greater than zero.\n", 32 );
+	}
+
+	if( vm.count("statistics") && vm["acceleration"].as<double>() < 0 ) {
+		throw parameter_error( "Error: --acceleration is negative.\n", 33 );
+	}
+
+	if( vm.count("feed-planning") && vm["acceleration"].as<double>() <= 0 ) {
+		throw parameter_error( "Error: --feed-planning needs an --acceleration greater than zero.\n", 34 );
+	}
+
+	if( vm.count("feed-planning") && vm["junction-deviation"].as<double>() <= 0 ) {
+		throw parameter_error( "Error: --junction-deviation has to be greater than zero.\n", 35 );
+	}
+
+	const char* gcode_outputs[] = { "front-output", "back-output", "outline-output", "drill-output" };
+	BOOST_FOREACH( const char* name, gcode_outputs ) {
+		if( OutputFile::unsupported( vm[name].as<string>() ) )
+			throw parameter_error( string("Error: --") + name + " needs zstd, which this pcb2gcode was built without.\n", 36 );
+	}
 
 	if( !vm.count("zsafe") ) {
-		cerr << "Error: Safety height not specified.\n";
-		exit(5);
+		throw parameter_error( "Error: Safety height not specified.\n", 5 );
 	}
 	if( !vm.count("zchange") ) {
-		cerr << "Error: Tool changing height not specified.\n";
-		exit(15);
+		throw parameter_error( "Error: Tool changing height not specified.\n", 15 );
 	}
 }
 
@@ -197,40 +324,41 @@ static void check_milling_parameters( po::variables_map const& vm )
 {
 	if(vm.count("front") || vm.count("back")) {
 		if( !vm.count("zwork") ) {
-			cerr << "Error: --zwork not specified.\n";
-			exit(1);
+			throw parameter_error( "Error: --zwork not specified.\n", 1 );
 		} else if( vm["zwork"].as<double>() > 0 ) {
-			cerr << "Warning: Engraving depth (--zwork) is greater than zero!\n";
+			LOG(LOG_WARNING) << "Warning: Engraving depth (--zwork) is greater than zero!\n";
 		}
 
 		if( !vm.count("offset") ) {
-			cerr << "Error: Etching --offset not specified.\n";
-			exit(4);
+			throw parameter_error( "Error: Etching --offset not specified.\n", 4 );
 		}
 		if( !vm.count("mill-feed") ) {
-			cerr << "Error: Milling feed [ipm] not specified.\n";
-			exit(13);
+			throw parameter_error( "Error: Milling feed [ipm] not specified.\n", 13 );
 		}
 		if( !vm.count("mill-speed") ) {
-			cerr << "Error: Milling speed [rpm] not specified.\n";
-			exit(14);
+			throw parameter_error( "Error: Milling speed [rpm] not specified.\n", 14 );
 		}
 		
 		// required parameters present. check for validity.
 		if( vm["zsafe"].as<double>() <= vm["zwork"].as<double>() ) {
-			cerr << "Error: The safety height --zsafe is lower than the milling "
-			     << "height --zwork. Are you sure this is correct?\n";
-			exit(15);
+			throw parameter_error( "Error: The safety height --zsafe is lower than the milling "
+			        "height --zwork. Are you sure this is correct?\n", 15 );
 		}
 
 		if( vm["mill-feed"].as<double>() < 0 ) {
-			cerr << "Error: Negative milling feed (--mill-feed).\n";
-			exit(17);
+			throw parameter_error( "Error: Negative milling feed (--mill-feed).\n", 17 );
 		}
 
 		if( vm["mill-speed"].as<int>() < 0 ) {
-			cerr << "Error: --mill-speed < 0.\n";
-			exit(16);
+			throw parameter_error( "Error: --mill-speed < 0.\n", 16 );
+		}
+
+		const char* engines[] = { "front-engine", "back-engine" };
+		BOOST_FOREACH( const char* engine, engines ) {
+			string value = vm[engine].as<string>();
+			if( value != "raster" && value != "polygon" ) {
+				throw parameter_error( string("Error: --") + engine + " has to be raster or polygon.\n", 30 );
+			}
 		}
 	}
 }
@@ -239,39 +367,31 @@ static void check_drilling_parameters( po::variables_map const& vm )
 {
 	if( vm.count("drill") ) {
 		if( !vm.count("zdrill") ) {
-			cerr << "Error: Drilling depth (--zdrill) not specified.\n";
-			exit(9);
+			throw parameter_error( "Error: Drilling depth (--zdrill) not specified.\n", 9 );
 		}
 		if( !vm.count("zchange") ) {
-			cerr << "Error: Drill bit changing height (--zchange) not specified.\n";
-			exit(10);
+			throw parameter_error( "Error: Drill bit changing height (--zchange) not specified.\n", 10 );
 		}
 		if( !vm.count("drill-feed") ) {
-			cerr << "Error:: Drilling feed (--drill-feed) not specified.\n";
-			exit(11);
+			throw parameter_error( "Error:: Drilling feed (--drill-feed) not specified.\n", 11 );
 		}
 		if( !vm.count("drill-speed") ) {
-			cerr << "Error: Drilling spindle RPM (--drill-speed) not specified.\n";
-			exit(12);
+			throw parameter_error( "Error: Drilling spindle RPM (--drill-speed) not specified.\n", 12 );
 		}
 		
 		if( vm["zsafe"].as<double>() <= vm["zdrill"].as<double>() ) {
-			cerr << "Error: The safety height --zsafe is lower than the drilling "
-			     << "height --zdrill!\n";
-			exit(18);
+			throw parameter_error( "Error: The safety height --zsafe is lower than the drilling "
+			        "height --zdrill!\n", 18 );
 		}
 		if( vm["zchange"].as<double>() <= vm["zdrill"].as<double>() ) {
-			cerr << "Error: The safety height --zsafe is lower than the tool "
-			     << "change height --zchange!\n";
-			exit(19);
+			throw parameter_error( "Error: The safety height --zsafe is lower than the tool "
+			        "change height --zchange!\n", 19 );
 		}
 		if( vm["drill-feed"].as<double>() <= 0 ) {
-			cerr << "Error: The drilling feed --drill-feed is <= 0.\n";
-			exit(20);
+			throw parameter_error( "Error: The drilling feed --drill-feed is <= 0.\n", 20 );
 		}
 		if( vm["drill-speed"].as<int>() < 0 ) {
-			cerr << "Error: --drill-speed < 0.\n";
-			exit(17);
+			throw parameter_error( "Error: --drill-speed < 0.\n", 17 );
 		}
 	}
 }
@@ -281,79 +401,87 @@ static void check_cutting_parameters( po::variables_map const& vm )
 	if( vm.count("outline") || (vm.count("drill") && vm.count("milldrill"))) {
 		if( vm.count("fill-outline") ) {
 			if(!vm.count("outline-width")) {
-				cerr << "Error: For outline filling, a width (--outline-width) has to be specified.\n";
-				exit(25);
+				throw parameter_error( "Error: For outline filling, a width (--outline-width) has to be specified.\n", 25 );
 			} else {
 				double outline_width = vm["outline-width"].as<double>();
 				if( outline_width < 0 ) {
-					cerr << "Error: Specified outline width is less than zero!\n";
-					exit(26);
+					throw parameter_error( "Error: Specified outline width is less than zero!\n", 26 );
 				} else if( outline_width == 0 ) {
-					cerr << "Error. Specified outline width is zero!\n";
-					exit(27);
+					throw parameter_error( "Error. Specified outline width is zero!\n", 27 );
 				} else {
 					std::stringstream width_sb;
 					if( (vm.count("metric") && outline_width >= 10)
 					    || (!vm.count("metric") && outline_width >= 0.4) ) {
 						
 						width_sb << outline_width << (vm.count("metric") ? " mm" : " inch");
-						cerr << "Warning: You specified an outline-width of " << width_sb.str() << "!\n";
+						LOG(LOG_WARNING) << "Warning: You specified an outline-width of " << width_sb.str() << "!\n";
 					}
 				}
 			}
 		}
 		if( !vm.count("zcut") ) {
-			cerr << "Error: Board cutting depth (--zcut) not specified.\n";
-			exit(5);
+			throw parameter_error( "Error: Board cutting depth (--zcut) not specified.\n", 5 );
 		}
 		if( !vm.count("cutter-diameter") ) {
-			cerr << "Error: Cutter diameter not specified.\n";
-			exit(15);
+			throw parameter_error( "Error: Cutter diameter not specified.\n", 15 );
 		}
 		if( !vm.count("cut-feed") ) {
-			cerr << "Error: Board cutting feed (--cut-feed) not specified.\n";
-			exit(6);
+			throw parameter_error( "Error: Board cutting feed (--cut-feed) not specified.\n", 6 );
 		}
 		if( !vm.count("cut-speed") ) {
-			cerr << "Error: Board cutting spindle RPM (--cut-speed) not specified.\n";
-			exit(7);
+			throw parameter_error( "Error: Board cutting spindle RPM (--cut-speed) not specified.\n", 7 );
 		}
 		if( !vm.count("cut-infeed") ) {
-			cerr << "Error: Board cutting infeed (--cut-infeed) not specified.\n";
-			exit(8);
+			throw parameter_error( "Error: Board cutting infeed (--cut-infeed) not specified.\n", 8 );
 		}
 
 		if( vm["zsafe"].as<double>() <= vm["zcut"].as<double>() ) {
-			cerr << "Error: The safety height --zsafe is lower than the cutting "
-			     << "height --zcut!\n";
-			exit(21);
+			throw parameter_error( "Error: The safety height --zsafe is lower than the cutting "
+			        "height --zcut!\n", 21 );
 		}
 		if( vm["cut-feed"].as<double>() <= 0 ) {
-			cerr << "Error: The cutting feed --cut-feed is <= 0.\n";
-			exit(22);
+			throw parameter_error( "Error: The cutting feed --cut-feed is <= 0.\n", 22 );
 		}
 		if( vm["cut-speed"].as<int>() < 0 ) {
-			cerr << "Error: The cutting spindle speed --cut-speed is smaler than 0.\n";
-			exit(23);
+			throw parameter_error( "Error: The cutting spindle speed --cut-speed is smaler than 0.\n", 23 );
 		}
 		if( vm["cut-infeed"].as<double>() < 0.001 ) {
-			cerr << "Error: Too small cutting infeed --cut-infeed.\n";
-			exit(24);
+			throw parameter_error( "Error: Too small cutting infeed --cut-infeed.\n", 24 );
 		}
 	}
 }
 
-void options::check_parameters()
+void options::check_parameters( po::variables_map const& vm )
 {
-	po::variables_map const& vm = instance().vm;
-
 	try {
+		::check_batch_parameters( vm );
 		check_generic_parameters( vm );
 		check_milling_parameters( vm );
 		check_cutting_parameters( vm );
 		check_drilling_parameters( vm );
+	} catch ( parameter_error& pe ) {
+		throw;
 	} catch ( std::runtime_error& re ) {
-		cerr << "Error: Invalid parameter. :-(\n";
-		exit(100);
+		throw parameter_error( "Error: Invalid parameter. :-(\n", 100 );
+	}
+}
+
+void options::check_batch_parameters()
+{
+	try {
+		::check_batch_parameters( instance().vm );
+	} catch ( parameter_error& pe ) {
+		cerr << pe.what();
+		exit( pe.code );
+	}
+}
+
+void options::check_parameters()
+{
+	try {
+		check_parameters( instance().vm );
+	} catch ( parameter_error& pe ) {
+		cerr << pe.what();
+		exit( pe.code );
 	}
 }
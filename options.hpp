@@ -34,13 +34,27 @@ namespace po = boost::program_options;
 #include <istream>
 #include <string>
 using std::string;
+#include <vector>
+using std::vector;
+
+//! an invalid or missing parameter; code is the program's exit status
+struct parameter_error : std::runtime_error
+{
+	parameter_error( const string& message, int code ) : std::runtime_error(message), code(code) {};
+
+	int code;
+};
 
 class options : boost::noncopyable
 {
 public:
 	static void parse( int argc, char** argv );
 	static void parse_files();
+	static void parse_job( const string& dir, const vector<string>& args, po::variables_map& vm );
 	static void check_parameters();
+	static void check_parameters( po::variables_map const& vm );
+	//! checks the options of the batch process itself, exits on errors
+	static void check_batch_parameters();
 
 	static po::variables_map& get_vm() { return instance().vm; };
 	static string help();
@@ -54,6 +68,7 @@ private:
 	po::options_description cfg_options; //! generic options
 
 	static options& instance();
+	static void store_output_defaults( po::variables_map& vm, po::options_description const& generic, int style );
 };
 
 
@@ -0,0 +1,338 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "output_file.hpp"
+#include "config.h"
+
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <vector>
+using std::vector;
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// size of the blocks handed to the writing thread, and how many of them may
+// wait there before the formatting has to
+static const size_t block_size = 1024 * 1024;
+static const size_t queued_blocks = 4;
+
+static bool ends_with( const string& s, const string& suffix )
+{
+	return s.size() >= suffix.size() && s.compare( s.size() - suffix.size(), suffix.size(), suffix ) == 0;
+}
+
+//! turns the text into the bytes of the file, false on errors
+class Encoder
+{
+public:
+	virtual ~Encoder() {};
+
+	virtual bool write( const char* data, size_t size, std::ostream& file ) = 0;
+	virtual bool finish( std::ostream& file ) = 0;
+};
+
+class PlainEncoder : public Encoder
+{
+public:
+	bool write( const char* data, size_t size, std::ostream& file )
+	{
+		file.write( data, size );
+		return file.good();
+	}
+
+	bool finish( std::ostream& file ) { return true; }
+};
+
+class GzipEncoder : public Encoder
+{
+public:
+	GzipEncoder() : out( block_size )
+	{
+		memset( &stream, 0, sizeof(stream) );
+		// 16 added to the window bits asks for a gzip header
+		ok = deflateInit2( &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) == Z_OK;
+	}
+
+	~GzipEncoder()
+	{
+		if( ok )
+			deflateEnd( &stream );
+	}
+
+	bool write( const char* data, size_t size, std::ostream& file ) { return deflate_all( data, size, Z_NO_FLUSH, file ); }
+	bool finish( std::ostream& file ) { return deflate_all( NULL, 0, Z_FINISH, file ); }
+
+private:
+	bool deflate_all( const char* data, size_t size, int flush, std::ostream& file )
+	{
+		if( !ok )
+			return false;
+
+		stream.next_in = (Bytef*) data;
+		stream.avail_in = size;
+
+		// until all the input is taken, or the end is written
+		int result;
+		do {
+			stream.next_out = (Bytef*) &out[0];
+			stream.avail_out = out.size();
+			result = deflate( &stream, flush );
+			if( result == Z_STREAM_ERROR )
+				return false;
+			file.write( &out[0], out.size() - stream.avail_out );
+		} while( flush == Z_FINISH ? result != Z_STREAM_END : stream.avail_out == 0 );
+
+		return file.good();
+	}
+
+	z_stream stream;
+	bool ok;
+	vector<char> out;
+};
+
+#ifdef HAVE_ZSTD
+class ZstdEncoder : public Encoder
+{
+public:
+	ZstdEncoder() : context( ZSTD_createCCtx() ), out( ZSTD_CStreamOutSize() ) {}
+	~ZstdEncoder() { ZSTD_freeCCtx( context ); }
+
+	bool write( const char* data, size_t size, std::ostream& file )
+	{
+		ZSTD_inBuffer in = { data, size, 0 };
+		while( in.pos < in.size ) {
+			ZSTD_outBuffer output = { &out[0], out.size(), 0 };
+			if( ZSTD_isError( ZSTD_compressStream2( context, &output, &in, ZSTD_e_continue ) ) )
+				return false;
+			file.write( &out[0], output.pos );
+		}
+		return file.good();
+	}
+
+	bool finish( std::ostream& file )
+	{
+		size_t remaining;
+		do {
+			ZSTD_inBuffer in = { NULL, 0, 0 };
+			ZSTD_outBuffer output = { &out[0], out.size(), 0 };
+			remaining = ZSTD_compressStream2( context, &output, &in, ZSTD_e_end );
+			if( ZSTD_isError( remaining ) )
+				return false;
+			file.write( &out[0], output.pos );
+		} while( remaining > 0 );
+		return file.good();
+	}
+
+private:
+	ZSTD_CCtx* context;
+	vector<char> out;
+};
+#endif
+
+//! collects the text in blocks for a thread that encodes and writes them
+class OutputBuffer : public std::streambuf
+{
+public:
+	//! NULL if the file can't be opened
+	static OutputBuffer* open( string filename );
+
+	~OutputBuffer() { close(); }
+
+	//! false if anything couldn't be written
+	bool close();
+
+protected:
+	int_type overflow( int_type c );
+	// blocks are only handed on when full, or when closing
+	int sync() { return 0; }
+
+private:
+	OutputBuffer( Encoder* encoder );
+
+	void hand_off();
+	void run();
+
+	std::ofstream file;
+	boost::scoped_ptr<Encoder> encoder;
+
+	vector<char> block;			// being filled
+	std::deque< vector<char> > queue;	// waiting for the writer
+	vector< vector<char> > spare;		// written, to be filled again
+	bool closing, closed, failed;
+
+	boost::mutex mutex;
+	boost::condition_variable changed;
+	boost::thread writer;
+};
+
+OutputBuffer::OutputBuffer( Encoder* encoder )
+	: encoder( encoder ), block( block_size ), closing(false), closed(false), failed(false)
+{
+	setp( &block[0], &block[0] + block.size() );
+}
+
+OutputBuffer*
+OutputBuffer::open( string filename )
+{
+	Encoder* encoder;
+	if( ends_with( filename, ".gz" ) )
+		encoder = new GzipEncoder();
+#ifdef HAVE_ZSTD
+	else if( ends_with( filename, ".zst" ) )
+		encoder = new ZstdEncoder();
+#endif
+	else
+		encoder = new PlainEncoder();
+
+	OutputBuffer* buffer = new OutputBuffer( encoder );
+	buffer->file.open( filename.c_str(), std::ios::binary | std::ios::trunc );
+	if( !buffer->file ) {
+		delete buffer;
+		return NULL;
+	}
+
+	buffer->writer = boost::thread( boost::bind( &OutputBuffer::run, buffer ) );
+	return buffer;
+}
+
+OutputBuffer::int_type
+OutputBuffer::overflow( int_type c )
+{
+	if( closed )
+		return traits_type::eof();
+
+	hand_off();
+	if( !traits_type::eq_int_type( c, traits_type::eof() ) ) {
+		*pptr() = traits_type::to_char_type( c );
+		pbump(1);
+	}
+	return traits_type::not_eof( c );
+}
+
+void
+OutputBuffer::hand_off()
+{
+	block.resize( pptr() - pbase() );
+
+	{
+		boost::mutex::scoped_lock lock( mutex );
+		while( queue.size() >= queued_blocks )
+			changed.wait( lock );
+
+		queue.push_back( vector<char>() );
+		queue.back().swap( block );
+		if( !spare.empty() ) {
+			block.swap( spare.back() );
+			spare.pop_back();
+		}
+	}
+	changed.notify_all();
+
+	block.resize( block_size );
+	setp( &block[0], &block[0] + block.size() );
+}
+
+// runs on the writer thread
+void
+OutputBuffer::run()
+{
+	bool ok = true;
+	vector<char> current;
+
+	while( true ) {
+		{
+			boost::mutex::scoped_lock lock( mutex );
+			while( queue.empty() && !closing )
+				changed.wait( lock );
+			if( queue.empty() )
+				break;
+
+			current.swap( queue.front() );
+			queue.pop_front();
+		}
+		changed.notify_all();
+
+		if( ok && !current.empty() )
+			ok = encoder->write( &current[0], current.size(), file );
+
+		boost::mutex::scoped_lock lock( mutex );
+		spare.push_back( vector<char>() );
+		spare.back().swap( current );
+	}
+
+	ok = ok && encoder->finish( file );
+	file.close();
+	failed = !ok || file.fail();
+}
+
+bool
+OutputBuffer::close()
+{
+	if( closed )
+		return !failed;
+
+	if( pptr() > pbase() )
+		hand_off();
+	closed = true;
+	setp( NULL, NULL );
+
+	{
+		boost::mutex::scoped_lock lock( mutex );
+		closing = true;
+	}
+	changed.notify_all();
+	writer.join();
+
+	return !failed;
+}
+
+OutputFile::OutputFile( string filename ) : std::ostream( NULL ), buffer( OutputBuffer::open( filename ) )
+{
+	if( buffer )
+		rdbuf( buffer.get() );
+}
+
+OutputFile::~OutputFile()
+{
+	close();
+}
+
+void
+OutputFile::close()
+{
+	if( buffer && !buffer->close() )
+		setstate( std::ios::badbit );
+}
+
+bool
+OutputFile::unsupported( string filename )
+{
+#ifdef HAVE_ZSTD
+	return false;
+#else
+	return ends_with( filename, ".zst" );
+#endif
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include <ostream>
+#include <string>
+using std::string;
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+class OutputBuffer;
+
+//! an output stream for the G-code files, compressed by the file name
+/*! Names ending in .gz are written with gzip, names ending in .zst with
+ *  zstd if it was available at compile time, everything else as it is.
+ *  The text is collected in large blocks that a separate thread compresses
+ *  and writes, so that the compression and the disk or network overlap the
+ *  formatting and the toolpath generation. Flushing doesn't hand on a
+ *  partial block; the file is complete once it is closed or destroyed.
+ *  The stream is bad if the file couldn't be opened or written.
+ */
+class OutputFile : public std::ostream, boost::noncopyable
+{
+public:
+	OutputFile( string filename );
+	~OutputFile();
+
+	void close();
+
+	//! true if the file name asks for a compression this build doesn't have
+	static bool unsupported( string filename );
+
+private:
+	boost::scoped_ptr<OutputBuffer> buffer;
+};
+
+#endif // OUTPUT_FILE_H
@@ -0,0 +1,208 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "polygon_engine.hpp"
+
+#include <cmath>
+#include <map>
+using std::map;
+
+#include "log.hpp"
+
+#include <boost/foreach.hpp>
+
+using namespace boost::polygon::operators;
+namespace gtl = boost::polygon;
+
+PolygonEngine::PolygonEngine( const vector<icoords>& polygons, ivalue_t min_x, ivalue_t max_x )
+	: masked(false), min_x(min_x), max_x(max_x)
+{
+	vector<polygon> areas;
+	to_polygon_set(polygons).get(areas);
+
+	// every polygon with its holes is a connected copper area
+	BOOST_FOREACH( polygon& area, areas ) {
+		polygon_set component;
+		component.insert(area);
+		components.push_back(component);
+	}
+}
+
+PolygonEngine::polygon_set
+PolygonEngine::to_polygon_set( const vector<icoords>& polygons )
+{
+	polygon_set united;
+
+	BOOST_FOREACH( const icoords& points, polygons ) {
+		vector< gtl::point_data<int> > scaled;
+		BOOST_FOREACH( const icoordpair& point, points ) {
+			scaled.push_back( gtl::point_data<int>( int( floor( point.first * units_per_inch + 0.5 ) ),
+							       int( floor( point.second * units_per_inch + 0.5 ) ) ) );
+		}
+
+		contour shape;
+		shape.set( scaled.begin(), scaled.end() );
+		united.insert(shape);
+	}
+
+	united.clean();
+	return united;
+}
+
+/* The mask is the area enclosed by the outline's polygons, reduced by
+ * shrink (half the line width for outlines drawn as lines).
+ */
+void
+PolygonEngine::set_mask( const vector<icoords>& outline, ivalue_t shrink )
+{
+	vector<polygon> areas;
+	to_polygon_set(outline).get(areas);
+
+	mask.clear();
+	BOOST_FOREACH( polygon& area, areas ) {
+		contour filled;
+		filled.set( area.begin(), area.end() );
+		mask.insert(filled);
+	}
+
+	masked = false;
+	if( shrink > 0 )
+		mask = grow( mask, -int( shrink * units_per_inch ) );
+	masked = true;
+}
+
+PolygonEngine::polygon_set
+PolygonEngine::grow( const polygon_set& area, int distance )
+{
+	polygon_set grown( area );
+
+	// approximate round corners with the same accuracy as the importer
+	ivalue_t radius = fabs( ivalue_t(distance) / units_per_inch );
+	int segments = radius > 0.0001 ? std::min( std::max( int( ceil( M_PI / acos( 1 - 0.0001 / radius ) ) ), 8 ), 256 ) : 8;
+	grown.resize( distance, true, segments );
+
+	if( masked )
+		grown &= mask;
+	return grown;
+}
+
+void
+PolygonEngine::get_toolpath( shared_ptr<RoutingMill> mill, bool mirrored, bool mirror_absolute, ToolpathSet& toolpath )
+{
+	Isolator* iso = dynamic_cast<Isolator*>(mill.get());
+	int extra_passes = iso?iso->extra_passes:0;
+
+	int radius = int( mill->tool_diameter / 2 * units_per_inch );
+	ivalue_t double_mirror_axis = mirror_absolute ? 0 : (min_x + max_x);
+	bool contentions = false;
+
+	toolpath.clear();
+
+	for( int pass = 0; pass <= extra_passes; pass++ )
+	{
+		int distance = radius * ( pass + 1 );
+
+		vector<polygon_set> grown;
+		BOOST_FOREACH( polygon_set& area, components ) {
+			grown.push_back( grow( area, distance ) );
+		}
+
+		// find the grown areas that overlap
+		vector< gtl::rectangle_data<int> > extents( grown.size() );
+		for( size_t i = 0; i < grown.size(); i++ )
+			gtl::extents( extents[i], grown[i] );
+
+		vector< vector<size_t> > neighbours( grown.size() );
+		for( size_t i = 0; i < grown.size(); i++ ) {
+			for( size_t j = i + 1; j < grown.size(); j++ ) {
+				if( !gtl::intersects( extents[i], extents[j] ) )
+					continue;
+
+				polygon_set overlap( grown[i] );
+				overlap &= grown[j];
+				if( !overlap.empty() ) {
+					neighbours[i].push_back(j);
+					neighbours[j].push_back(i);
+				}
+			}
+		}
+
+		/* contending areas meet in the middle: they are grown in steps,
+		 * and every step only claims what isn't within the previous step
+		 * of a neighbour.
+		 */
+		int step = std::max( radius / contention_steps, 1 );
+		int steps = ( distance + step - 1 ) / step;
+		map< size_t, vector<polygon_set> > levels;
+
+		for( size_t i = 0; i < grown.size(); i++ ) {
+			if( neighbours[i].empty() )
+				continue;
+			contentions = true;
+
+			vector<size_t> involved( neighbours[i] );
+			involved.push_back(i);
+			BOOST_FOREACH( size_t j, involved ) {
+				if( levels.count(j) )
+					continue;
+				vector<polygon_set>& level = levels[j];
+				level.push_back( components[j] );
+				for( int s = 1; s <= steps; s++ )
+					level.push_back( grow( components[j], std::min( s * step, distance ) ) );
+			}
+
+			polygon_set claimed;
+			for( int s = 1; s <= steps; s++ ) {
+				polygon_set others;
+				BOOST_FOREACH( size_t j, neighbours[i] ) {
+					others += levels[j][s - 1];
+				}
+				claimed += levels[i][s] - others;
+			}
+			grown[i] = claimed;
+		}
+
+		// only the outer boundaries get milled
+		BOOST_FOREACH( polygon_set& area, grown ) {
+			vector<polygon> parts;
+			area.get(parts);
+
+			BOOST_FOREACH( polygon& part, parts ) {
+				if( part.begin() == part.end() )
+					continue;
+
+				toolpath.begin_contour( true, pass );
+				for( polygon::iterator_type it = part.begin(); it != part.end(); it++ ) {
+					ivalue_t x = ivalue_t( gtl::x(*it) ) / units_per_inch;
+					ivalue_t y = ivalue_t( gtl::y(*it) ) / units_per_inch;
+					toolpath.add_point( mirrored ? (double_mirror_axis - x) : x, y );
+				}
+				size_t first = toolpath.contour_begin( toolpath.size() - 1 );
+				toolpath.add_point( toolpath.x(first), toolpath.y(first) );
+			}
+		}
+	}
+
+	if(contentions) {
+		LOG(LOG_WARNING) << "Warning: pcb2gcode hasn't been able to fulfill all"
+				 << " clearance requirements and tried a best effort approach"
+				 << " instead. You may want to check the g-code output and"
+				 << " possibly use a smaller milling width.\n";
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POLYGON_ENGINE_H
+#define POLYGON_ENGINE_H
+
+#include <vector>
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+#include <boost/polygon/polygon.hpp>
+
+#include "coord.hpp"
+#include "toolpath.hpp"
+#include "mill.hpp"
+
+//! Calculates isolation toolpaths from polygons instead of a photoplot.
+/*! The polygons of a layer are united and every connected copper area is
+ *  offset by the tool radius, once more for each extra pass. Where grown
+ *  areas would overlap, they are grown in small steps instead, each step
+ *  giving way to what the neighbours occupied a step earlier, which meets
+ *  in the middle like the pixel growing of Surface does.
+ *
+ *  The work depends on the number of features, not on the board area and
+ *  resolution. Coordinates are kept as integers in units of
+ *  1/units_per_inch inch for robust boolean operations.
+ */
+class PolygonEngine : boost::noncopyable
+{
+public:
+	PolygonEngine( const vector<icoords>& polygons, ivalue_t min_x, ivalue_t max_x );
+
+	//! restricts growing to the inside of the given board outline
+	void set_mask( const vector<icoords>& outline, ivalue_t shrink );
+
+	void get_toolpath( shared_ptr<RoutingMill> mill, bool mirrored, bool mirror_absolute, ToolpathSet& toolpath );
+
+private:
+	typedef boost::polygon::polygon_set_data<int> polygon_set;
+	typedef boost::polygon::polygon_with_holes_data<int> polygon;
+	typedef boost::polygon::polygon_data<int> contour;
+
+	static const int units_per_inch = 100000;
+	// steps per tool radius when grown areas contend
+	static const int contention_steps = 16;
+
+	static polygon_set to_polygon_set( const vector<icoords>& polygons );
+	polygon_set grow( const polygon_set& area, int distance );
+
+	vector<polygon_set> components;
+	polygon_set mask;
+	bool masked;
+	ivalue_t min_x;
+	ivalue_t max_x;
+};
+
+#endif // POLYGON_ENGINE_H
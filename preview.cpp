@@ -0,0 +1,175 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "preview.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <gdkmm/pixbuf.h>
+
+using std::min;
+using std::max;
+
+// blank pixels around the drawing
+static const int margin = 4;
+
+Preview::Preview( uint size ) : size( max(size, 2U * margin + 1) ), width(0), height(0)
+{
+}
+
+void Preview::add_toolpaths( const ToolpathSet& toolpaths, ivalue_t tool_diameter, guint32 color )
+{
+	strokes.push_back( Stroke() );
+	Stroke& stroke = strokes.back();
+	stroke.width = tool_diameter;
+	stroke.color = color;
+
+	stroke.xs.reserve( toolpaths.point_count() );
+	stroke.ys.reserve( toolpaths.point_count() );
+	for( size_t contour = 0; contour < toolpaths.size(); contour++ ) {
+		stroke.breaks.push_back( stroke.xs.size() );
+		for( size_t i = toolpaths.contour_begin(contour); i != toolpaths.contour_end(contour); i++ ) {
+			stroke.xs.push_back( toolpaths.x(i) );
+			stroke.ys.push_back( toolpaths.y(i) );
+		}
+	}
+	stroke.breaks.push_back( stroke.xs.size() );
+}
+
+void Preview::add_hole( ivalue_t x, ivalue_t y, ivalue_t diameter, guint32 color )
+{
+	Hole hole = { x, y, diameter, color };
+	holes.push_back( hole );
+}
+
+Preview::Brush Preview::make_brush( int radius )
+{
+	Brush brush( 2 * radius + 1 );
+	for( int dy = -radius; dy <= radius; dy++ )
+		brush[dy + radius] = int( sqrt( double(radius * radius - dy * dy) ) );
+	return brush;
+}
+
+void Preview::stamp( int x, int y, const Brush& brush, guint32 color )
+{
+	const int radius = brush.size() / 2;
+	const guint8 r = color >> 16, g = color >> 8, b = color;
+
+	for( int dy = -radius; dy <= radius; dy++ ) {
+		const int row = y + dy;
+		if( row < 0 || row >= int(height) )
+			continue;
+
+		const int half = brush[dy + radius];
+		const int left = max( x - half, 0 ), right = min( x + half, int(width) - 1 );
+		if( left > right )
+			continue;
+
+		guint8* p = &pixels[ ( size_t(row) * width + left ) * 3 ];
+		for( int col = left; col <= right; col++ ) {
+			*p++ = r;
+			*p++ = g;
+			*p++ = b;
+		}
+	}
+}
+
+//! Bresenham's line, with the brush at every pixel
+void Preview::line( int x0, int y0, int x1, int y1, const Brush& brush, guint32 color )
+{
+	const int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+	const int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+	int error = dx + dy;
+
+	while( true ) {
+		stamp( x0, y0, brush, color );
+		if( x0 == x1 && y0 == y1 )
+			break;
+
+		const int e2 = 2 * error;
+		if( e2 >= dy ) {
+			error += dy;
+			x0 += sx;
+		}
+		if( e2 <= dx ) {
+			error += dx;
+			y0 += sy;
+		}
+	}
+}
+
+void Preview::save( string filename )
+{
+	// the extent of everything, including the widths of the strokes
+	double min_x = INFINITY, max_x = -INFINITY, min_y = INFINITY, max_y = -INFINITY;
+	for( vector<Stroke>::const_iterator s = strokes.begin(); s != strokes.end(); s++ ) {
+		for( size_t i = 0; i < s->xs.size(); i++ ) {
+			min_x = min( min_x, s->xs[i] - s->width / 2 );
+			max_x = max( max_x, s->xs[i] + s->width / 2 );
+			min_y = min( min_y, s->ys[i] - s->width / 2 );
+			max_y = max( max_y, s->ys[i] + s->width / 2 );
+		}
+	}
+	for( vector<Hole>::const_iterator h = holes.begin(); h != holes.end(); h++ ) {
+		min_x = min( min_x, h->x - h->diameter / 2 );
+		max_x = max( max_x, h->x + h->diameter / 2 );
+		min_y = min( min_y, h->y - h->diameter / 2 );
+		max_y = max( max_y, h->y + h->diameter / 2 );
+	}
+	if( !( min_x < max_x ) || !( min_y < max_y ) ) {
+		min_x = min_y = 0;
+		max_x = max_y = 1;
+	}
+
+	// the longer side gets size pixels, so narrow boards don't make huge images
+	const double scale = ( size - 1 - 2 * margin ) / max( max_x - min_x, max_y - min_y );
+	width = min( uint( ceil( (max_x - min_x) * scale ) ) + 2 * margin + 1, size );
+	height = min( uint( ceil( (max_y - min_y) * scale ) ) + 2 * margin + 1, size );
+	pixels.assign( size_t(width) * height * 3, 0xFF );
+
+	// G-code coordinates to pixels, with Y pointing up
+	#define PREVIEW_X(x) ( int( lround( ((x) - min_x) * scale ) ) + margin )
+	#define PREVIEW_Y(y) ( int(height) - 1 - margin - int( lround( ((y) - min_y) * scale ) ) )
+
+	for( vector<Stroke>::const_iterator s = strokes.begin(); s != strokes.end(); s++ ) {
+		const Brush brush = make_brush( int( lround( s->width * scale / 2 ) ) );
+		for( size_t contour = 0; contour + 1 < s->breaks.size(); contour++ ) {
+			size_t begin = s->breaks[contour], end = s->breaks[contour + 1];
+			int x = PREVIEW_X( s->xs[begin] ), y = PREVIEW_Y( s->ys[begin] );
+			stamp( x, y, brush, s->color );
+			for( size_t i = begin + 1; i < end; i++ ) {
+				int next_x = PREVIEW_X( s->xs[i] ), next_y = PREVIEW_Y( s->ys[i] );
+				line( x, y, next_x, next_y, brush, s->color );
+				x = next_x;
+				y = next_y;
+			}
+		}
+	}
+
+	for( vector<Hole>::const_iterator h = holes.begin(); h != holes.end(); h++ )
+		stamp( PREVIEW_X( h->x ), PREVIEW_Y( h->y ), make_brush( int( lround( h->diameter * scale / 2 ) ) ), h->color );
+
+	#undef PREVIEW_X
+	#undef PREVIEW_Y
+
+	Gdk::Pixbuf::create_from_data( &pixels[0], Gdk::COLORSPACE_RGB, false, 8,
+				       width, height, width * 3 )->save( filename, "png" );
+}
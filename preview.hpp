@@ -0,0 +1,84 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+
+#include <glibmm/error.h>
+#include <glibmm/ustring.h>
+
+#include "coord.hpp"
+#include "toolpath.hpp"
+
+//! a small picture of the final toolpaths and drill holes
+/*! The toolpaths and holes are collected in G-code coordinates and drawn
+ *  when saving, into an image that fits around all of them, with the
+ *  given size on its longer side. The paths are stroked as wide as the
+ *  tool that mills them, with an integer line and disc rasteriser.
+ */
+class Preview : public boost::noncopyable
+{
+public:
+	//! size is the length of the longer side of the picture in pixels
+	Preview( uint size );
+
+	//! colors as 0xRRGGBB
+	void add_toolpaths( const ToolpathSet& toolpaths, ivalue_t tool_diameter, guint32 color );
+	void add_hole( ivalue_t x, ivalue_t y, ivalue_t diameter, guint32 color );
+
+	//! writes the picture as PNG, throws Glib::Error
+	void save( string filename );
+
+private:
+	struct Stroke {
+		vector<double> xs, ys;
+		vector<size_t> breaks;		// where each contour begins
+		ivalue_t width;
+		guint32 color;
+	};
+
+	struct Hole {
+		ivalue_t x, y, diameter;
+		guint32 color;
+	};
+
+	//! the pixel offsets of a disc, as half the width of each row
+	typedef vector<int> Brush;
+	static Brush make_brush( int radius );
+
+	void stamp( int x, int y, const Brush& brush, guint32 color );
+	void line( int x0, int y0, int x1, int y1, const Brush& brush, guint32 color );
+
+	const uint size;
+	uint width, height;
+	vector<guint8> pixels;		// RGB
+
+	vector<Stroke> strokes;
+	vector<Hole> holes;
+};
+
+#endif // PREVIEW_H
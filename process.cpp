@@ -0,0 +1,452 @@
+/*
+ * This file is part of pcb2gcode.
+ *
+ * Copyright (C) 2009, 2010, 2011 Patrick Birnzain <pbirnzain@users.sourceforge.net> and others
+ *
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "process.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using std::endl;
+using std::fstream;
+
+#include "gerberimporter.hpp"
+#include "surface.hpp"
+#include "ngc_exporter.hpp"
+#include "smooth_ngc_exporter.hpp"
+#include "board.hpp"
+#include "toolpath_cache.hpp"
+#include "drill.hpp"
+#include "svg_exporter.hpp"
+#include "preview.hpp"
+#include "statistics.hpp"
+#include "feed_planner.hpp"
+#include "binary_exporter.hpp"
+#include "estimator.hpp"
+#include "dependencies.hpp"
+#include "hash.hpp"
+#include "log.hpp"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/foreach.hpp>
+
+#include "config.h"
+
+/* Lists the settings of a mill that end up in the G-code, for the
+ * dependency manifest.
+ */
+static string mill_settings( shared_ptr<Mill> mill )
+{
+	std::ostringstream settings;
+	settings.precision(17);
+	settings << "mill " << mill->feed << " " << mill->speed << " " << mill->zchange << " "
+		 << mill->zsafe << " " << mill->zwork << "\n";
+
+	shared_ptr<RoutingMill> routing = boost::dynamic_pointer_cast<RoutingMill>(mill);
+	if( routing )
+		settings << "tool " << routing->tool_diameter << "\n";
+
+	shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>(mill);
+	if( cutter )
+		settings << "steps " << cutter->do_steps << " " << cutter->stepsize << "\n";
+
+	return settings.str();
+}
+
+/* Converts the board described by vm. Progress is logged, errors that
+ * prevent processing the board are thrown as std::runtime_error.
+ */
+void process_board( po::variables_map& vm )
+{
+	double unit=1;
+	if( vm.count("metric") ) {
+		unit=1./25.4;
+	}
+
+	// prepare environment
+	shared_ptr<Isolator> isolator;
+	if( vm.count("front") || vm.count("back") ) {
+		isolator = shared_ptr<Isolator>( new Isolator() );
+		isolator->tool_diameter = vm["offset"].as<double>() * 2*unit;
+		isolator->zwork = vm["zwork"].as<double>()*unit;
+		isolator->zsafe = vm["zsafe"].as<double>()*unit;
+		isolator->feed = vm["mill-feed"].as<double>()*unit;
+		isolator->speed = vm["mill-speed"].as<int>();
+		isolator->zchange = vm["zchange"].as<double>()*unit;
+		isolator->extra_passes = vm.count("extra-passes")?vm["extra-passes"].as<int>():0;
+	}
+
+	shared_ptr<Cutter> cutter;
+	if( vm.count("outline") || (vm.count("drill") && vm.count("milldrill")) ) {
+		cutter = shared_ptr<Cutter>( new Cutter() );
+		cutter->tool_diameter = vm["cutter-diameter"].as<double>()*unit;
+		cutter->zwork = vm["zcut"].as<double>()*unit;
+		cutter->zsafe = vm["zsafe"].as<double>()*unit;
+		cutter->feed = vm["cut-feed"].as<double>()*unit;
+		cutter->speed = vm["cut-speed"].as<int>();
+		cutter->zchange = vm["zchange"].as<double>()*unit;
+		cutter->do_steps = true;
+		cutter->stepsize = vm["cut-infeed"].as<double>()*unit;
+	}
+
+	shared_ptr<Driller> driller;
+	if( vm.count("drill") ) {
+		driller = shared_ptr<Driller>( new Driller() );
+		driller->zwork = vm["zdrill"].as<double>()*unit;
+		driller->zsafe = vm["zsafe"].as<double>()*unit;
+		driller->feed = vm["drill-feed"].as<double>()*unit;
+		driller->speed = vm["drill-speed"].as<int>();
+		driller->zchange = vm["zchange"].as<double>()*unit;
+	}
+
+	// prepare custom preamble
+	string preamble, postamble;
+	if( vm.count("preamble") )
+	{
+		string name = vm["preamble"].as<string>();
+		fstream in(name.c_str(),fstream::in);
+		if(!in.good())
+		{
+			throw std::runtime_error( "Cannot read preamble file \"" + name + "\"" );
+		}
+		string tmp((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		preamble = tmp + "\n\n";
+	}
+
+	if( vm.count("postamble") )
+	{
+		string name = vm["postamble"].as<string>();
+		fstream in(name.c_str(),fstream::in);
+		if(!in.good())
+		{
+			throw std::runtime_error( "Cannot read preamble file \"" + name + "\"" );
+		}
+		string tmp((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		postamble = tmp + "\n\n";
+	}
+
+	shared_ptr<Board> board( new Board( vm["dpi"].as<int>(), vm.count("fill-outline"), vm.count("fill-outline") ? vm["outline-width"].as<double>() * unit : INFINITY ));
+
+	if( vm.count("auto-dpi") )
+		board->set_auto_dpi( vm["memory-budget"].as<double>() * 1024 * 1024 );
+
+	if( vm.count("marching-squares") )
+		board->set_marching_squares( true );
+
+	if( vm.count("cache-dir") )
+		board->set_toolpath_cache( shared_ptr<ToolpathCache>(
+			new ToolpathCache( vm["cache-dir"].as<string>(), vm["cache-size"].as<double>() * 1024 * 1024 ) ) );
+
+	// this is currently disabled, use --outline instead
+	if( vm.count("margins") )
+		board->set_margins( vm["margins"].as<double>() );
+
+	// load files
+	try
+	{
+		// import layer files, create surface
+		LOG(LOG_INFO) << "Importing front side... ";
+		try {
+			string frontfile = vm["front"].as<string>();
+			boost::shared_ptr<LayerImporter> importer( new GerberImporter(frontfile) );
+			board->prepareLayer( "front", importer, isolator, false, vm.count("mirror-absolute") );
+			LOG(LOG_INFO) << "done\n";
+		} catch( import_exception& i ) {
+			LOG(LOG_INFO) << "error\n";
+		} catch( boost::exception& e ) {
+			LOG(LOG_INFO) << "not specified\n";
+		}
+
+		LOG(LOG_INFO) << "Importing back side... ";
+		try {
+			string backfile = vm["back"].as<string>();
+			boost::shared_ptr<LayerImporter> importer( new GerberImporter(backfile) );
+			board->prepareLayer( "back", importer, isolator, true, vm.count("mirror-absolute") );
+			LOG(LOG_INFO) << "done\n";
+		} catch( import_exception& i ) {
+			LOG(LOG_INFO) << "error\n";
+		} catch( boost::exception& e ) {
+			LOG(LOG_INFO) << "not specified\n";
+		}
+
+		LOG(LOG_INFO) << "Importing outline... ";
+		try {
+			string outline = vm["outline"].as<string>();
+			boost::shared_ptr<LayerImporter> importer( new GerberImporter(outline) );
+			board->prepareLayer( "outline", importer, cutter, !vm.count("front"), vm.count("mirror-absolute") );
+			LOG(LOG_INFO) << "done\n";
+		} catch( import_exception& i ) {
+			LOG(LOG_INFO) << "error\n";
+		} catch( boost::exception& e ) {
+			LOG(LOG_INFO) << "not specified\n";
+		}
+
+
+		if( vm["front-engine"].as<string>() == "polygon" )
+			board->use_polygon_engine("front");
+		if( vm["back-engine"].as<string>() == "polygon" )
+			board->use_polygon_engine("back");
+	}
+	catch(import_exception ie)
+	{
+		if( ustring const* mes = boost::get_error_info<errorstring>(ie) )
+			LOG(LOG_ERROR) << "Import Error: " << *mes;
+		else
+			LOG(LOG_ERROR) << "Import Error: No reason given.";
+	}
+
+
+	if( vm.count("estimate") ) {
+		try {
+			CostEstimator estimator( board );
+			estimator.print_summary( Log::stream() );
+
+			string of_name = vm["estimate-output"].as<string>();
+			std::ofstream of( of_name.c_str() );
+			estimator.write_json( of );
+			LOG(LOG_INFO) << "Estimate written to " << of_name << endl;
+		} catch( std::logic_error& le ) {
+			throw std::runtime_error( string("Internal Error: ") + le.what() );
+		}
+		return;
+	}
+
+	double acceleration = vm["acceleration"].as<double>() * unit;
+	double junction_deviation = vm["junction-deviation"].as<double>() * unit;
+
+	// find the outputs that are still up to date
+	shared_ptr<DependencyManifest> deps;
+	string export_settings;
+	map< string, string > layer_descriptions;
+
+	if( vm.count("incremental") ) {
+		if( vm.count("svg") || vm.count("preview") || vm.count("binary") || vm.count("statistics") ) {
+			LOG(LOG_INFO) << "Regenerating all files, the SVG, preview, binary and statistics outputs need every layer." << endl;
+		} else {
+			deps.reset( new DependencyManifest( vm["deps-output"].as<string>() ) );
+
+			std::ostringstream settings;
+			settings << "header " << PACKAGE_STRING << "\n"
+				 << "smooth " << vm.count("smooth") << "\n"
+				 << "preamble " << Hash().add(preamble).hex() << "\n"
+				 << "postamble " << Hash().add(postamble).hex() << "\n"
+				 << "planning " << vm.count("feed-planning") << " " << acceleration << " "
+				 << junction_deviation << "\n";
+			export_settings = settings.str();
+
+			try {
+				board->calculateDimensions();
+
+				BOOST_FOREACH( string layername, board->list_prepared_layers() ) {
+					string output = vm[layername + "-output"].as<string>();
+					string description = board->get_layer_key(layername)
+						+ mill_settings( board->get_manufacturer(layername) ) + export_settings;
+
+					if( deps->is_current( output, description ) ) {
+						board->skip_layer(layername);
+						LOG(LOG_INFO) << output << " is up to date." << endl;
+					} else {
+						layer_descriptions[output] = description;
+					}
+				}
+			} catch( std::logic_error& le ) {
+				// no layers prepared, reported below
+			}
+		}
+	}
+
+	//SVG EXPORTER
+	shared_ptr<SVG_Exporter> svgexpo( new SVG_Exporter( board ) );
+
+	shared_ptr<BinaryExporter> binary;
+	if( vm.count("binary") )
+		binary.reset( new BinaryExporter( board ) );
+
+	shared_ptr<Preview> preview;
+	if( vm.count("preview") )
+		preview.reset( new Preview( vm["preview-width"].as<int>() ) );
+
+	shared_ptr<JobStatistics> statistics;
+	if( vm.count("statistics") ) {
+		machine_limits limits;
+		limits.rapid_feed = vm["rapid-feed"].as<double>() * unit;
+		limits.acceleration = acceleration;
+		limits.junction_deviation = vm.count("feed-planning") ? junction_deviation : 0;
+		statistics.reset( new JobStatistics( limits ) );
+	}
+	
+	try {
+		board->createLayers();   // throws std::logic_error
+		LOG(LOG_INFO) << "Calculated board dimensions: " << board->get_width() << "in x " << board->get_height() << "in" << endl;
+
+		
+		//SVG EXPORTER
+		if( vm.count("svg") ) {
+			LOG(LOG_INFO) << "Create SVG File ... " << vm["svg"].as<string>() << endl;
+			svgexpo->create_svg( vm["svg"].as<string>() );
+		}
+		
+        if( vm.count("smooth") ) { LOG(LOG_INFO) << "Enabling Douglas-Peucker smoothing algorithm." << endl; }
+		shared_ptr<NGC_Exporter> exporter( vm.count("smooth") ? new SNGC_Exporter( board ) : new NGC_Exporter( board ) );
+		exporter->add_header( PACKAGE_STRING );
+		if( vm.count("preamble") ) exporter->set_preamble(preamble);
+		if( vm.count("postamble") ) exporter->set_postamble(postamble);
+		
+		//SVG EXPORTER
+		if( vm.count("svg") ) exporter->set_svg_exporter( svgexpo );
+
+		shared_ptr<FeedPlanner> planner;
+		if( vm.count("feed-planning") ) {
+			planner.reset( new FeedPlanner( acceleration, junction_deviation ) );
+			exporter->set_feed_planner( planner );
+		}
+		
+		exporter->export_all(vm);
+
+		if( planner )
+			planner->print_summary( Log::stream() );
+
+		if( preview ) {
+			BOOST_FOREACH( string layername, board->list_layers() ) {
+				guint32 color = layername == "front" ? 0xC04000 : layername == "back" ? 0x0040C0 : 0x000000;
+				preview->add_toolpaths( board->get_toolpath(layername),
+							board->get_manufacturer(layername)->tool_diameter, color );
+			}
+		}
+
+		if( statistics ) {
+			BOOST_FOREACH( string layername, board->list_layers() ) {
+				statistics->add_layer( layername, board->get_toolpath(layername),
+						       board->get_manufacturer(layername) );
+			}
+		}
+
+		if( deps ) {
+			for( map< string, string >::iterator it = layer_descriptions.begin(); it != layer_descriptions.end(); it++ )
+				deps->record( it->first, it->second );
+		}
+	} catch( std::logic_error& le ) {
+		LOG(LOG_ERROR) << "Internal Error: " << le.what() << endl;
+	} catch( std::runtime_error& re ) {
+	}
+
+	if( vm.count("drill") ) {
+		string drill_output = vm["drill-output"].as<string>();
+		string drill_description;
+
+		if( deps ) {
+			std::ostringstream description;
+			description.precision(17);
+			description << "input " << Hash().add_file( vm["drill"].as<string>() ).hex() << "\n"
+				    << "mirror " << board->get_min_x() + board->get_max_x() << " "
+				    << !vm.count("drill-front") << " " << vm.count("mirror-absolute") << "\n"
+				    << "milldrill " << vm.count("milldrill") << "\n"
+				    << mill_settings( vm.count("milldrill") ? shared_ptr<Mill>(cutter) : shared_ptr<Mill>(driller) )
+				    << export_settings;
+			drill_description = description.str();
+		}
+
+		if( deps && deps->is_current( drill_output, drill_description ) ) {
+			LOG(LOG_INFO) << drill_output << " is up to date." << endl;
+		} else {
+			LOG(LOG_INFO) << "Converting " << vm["drill"].as<string>() << "... ";
+			try {
+				ExcellonProcessor ep( vm["drill"].as<string>(), board->get_min_x() + board->get_max_x() );
+				ep.add_header( PACKAGE_STRING );
+				if( vm.count("preamble") ) ep.set_preamble(preamble);
+				if( vm.count("postamble") ) ep.set_postamble(postamble);
+
+				//SVG EXPORTER
+				if( vm.count("svg") ) ep.set_svg_exporter( svgexpo );
+				
+				
+				if( vm.count("milldrill") )
+					ep.export_ngc( drill_output, cutter, !vm.count("drill-front"), vm.count("mirror-absolute") );
+				else
+					ep.export_ngc( drill_output, driller, !vm.count("drill-front"), vm.count("mirror-absolute") );
+
+				if( deps )
+					deps->record( drill_output, drill_description );
+
+				if( preview ) {
+					// at the positions of the G-code
+					bool mirrored = !vm.count("drill-front");
+					ivalue_t axis = vm.count("mirror-absolute") ? 0 : board->get_min_x() + board->get_max_x();
+					shared_ptr<const map<int,drillbit> > bits = ep.get_bits();
+					shared_ptr<const map<int,icoords> > holes = ep.get_holes();
+
+					for( map<int,icoords>::const_iterator it = holes->begin(); it != holes->end(); it++ ) {
+						const drillbit& bit = bits->at(it->first);
+						ivalue_t diameter = bit.unit == "mm" ? bit.diameter / 25.4 : bit.diameter;
+						BOOST_FOREACH( const icoordpair& hole, it->second )
+							preview->add_hole( mirrored ? axis - hole.first : hole.first, hole.second,
+									   diameter, 0x008000 );
+					}
+				}
+
+				if( binary ) {
+					binary->add_drill( *ep.get_bits(), *ep.get_holes(), !vm.count("drill-front"),
+							   vm.count("mirror-absolute") ? 0 : board->get_min_x() + board->get_max_x() );
+				}
+
+				if( statistics ) {
+					statistics->add_drill( "drill", *ep.get_bits(), *ep.get_holes(),
+							       vm.count("milldrill") ? shared_ptr<Mill>(cutter) : shared_ptr<Mill>(driller) );
+				}
+
+				LOG(LOG_INFO) << "done.\n";
+			} catch( drill_exception& e ) {
+				LOG(LOG_INFO) << "ERROR.\n";
+			}
+		}
+	} else {
+		LOG(LOG_INFO) << "No drill file specified.\n";
+	}
+
+	if( preview ) {
+		try {
+			preview->save( vm["preview"].as<string>() );
+			LOG(LOG_INFO) << "Preview written to " << vm["preview"].as<string>() << endl;
+		} catch( Glib::Error& e ) {
+			LOG(LOG_ERROR) << "Error writing the preview: " << e.what() << endl;
+		}
+	}
+
+	if( binary ) {
+		try {
+			binary->export_all( vm );
+			LOG(LOG_INFO) << "Toolpaths written to " << vm["binary"].as<string>() << endl;
+		} catch( std::exception& e ) {
+			LOG(LOG_ERROR) << "Error writing the binary toolpaths: " << e.what() << endl;
+		}
+	}
+
+	if( statistics && !statistics->empty() ) {
+		statistics->print_summary( Log::stream() );
+
+		string of_name = vm["statistics-output"].as<string>();
+		std::ofstream of( of_name.c_str() );
+		statistics->write_json( of );
+		LOG(LOG_INFO) << "Statistics written to " << of_name << endl;
+	}
+
+	if( deps )
+		deps->save();
+}
@@ -0,0 +1,320 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rasterops.hpp"
+#include "config.h"
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && \
+    ( defined(__clang__) || __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) )
+// the vectorised kernels are compiled for their instruction set through
+// target attributes, so the rest of the program doesn't need it
+#define RASTEROPS_X86
+#include <immintrin.h>
+#endif
+
+namespace rasterops
+{
+
+namespace
+{
+
+/* The plain kernels. They also do the ends of the rows the vectorised
+ * ones leave over.
+ */
+
+void fill_scalar( uint32_t* row, size_t n, uint32_t value )
+{
+	for( size_t i = 0; i < n; i++ )
+		row[i] = value;
+}
+
+void set_bits_scalar( uint32_t* row, size_t n, uint32_t bits )
+{
+	for( size_t i = 0; i < n; i++ )
+		row[i] |= bits;
+}
+
+void mask_scalar( uint32_t* row, const uint32_t* mask, size_t n, uint32_t tint )
+{
+	for( size_t i = 0; i < n; i++ )
+		row[i] = ( row[i] & mask[i] ) | ( ~mask[i] & tint );
+}
+
+bool remap_scalar( uint32_t* row, size_t n, uint32_t match, uint32_t if_equal, uint32_t if_different )
+{
+	bool different = false;
+	for( size_t i = 0; i < n; i++ ) {
+		if( row[i] == match ) {
+			row[i] = if_equal;
+		} else {
+			row[i] = if_different;
+			different = true;
+		}
+	}
+	return different;
+}
+
+void expand_bits_scalar( uint32_t* row, const uint32_t* bits, size_t n, uint32_t value )
+{
+	for( size_t i = 0; i < n; i++ ) {
+		uint32_t word = bits[i / 32];
+		if( !word ) {
+			i += 31;
+			continue;
+		}
+#ifdef WORDS_BIGENDIAN
+		if( word & ( 0x80000000U >> (i % 32) ) )
+#else
+		if( word & ( 1U << (i % 32) ) )
+#endif
+			row[i] = value;
+	}
+}
+
+#ifdef RASTEROPS_X86
+
+__attribute__((target("sse2")))
+void fill_sse2( uint32_t* row, size_t n, uint32_t value )
+{
+	const __m128i v = _mm_set1_epi32( value );
+	size_t i = 0;
+	for( ; i + 4 <= n; i += 4 )
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(row + i), v );
+	fill_scalar( row + i, n - i, value );
+}
+
+__attribute__((target("sse2")))
+void set_bits_sse2( uint32_t* row, size_t n, uint32_t bits )
+{
+	const __m128i b = _mm_set1_epi32( bits );
+	size_t i = 0;
+	for( ; i + 4 <= n; i += 4 ) {
+		__m128i* p = reinterpret_cast<__m128i*>(row + i);
+		_mm_storeu_si128( p, _mm_or_si128( _mm_loadu_si128(p), b ) );
+	}
+	set_bits_scalar( row + i, n - i, bits );
+}
+
+__attribute__((target("sse2")))
+void mask_sse2( uint32_t* row, const uint32_t* mask, size_t n, uint32_t tint )
+{
+	const __m128i t = _mm_set1_epi32( tint );
+	size_t i = 0;
+	for( ; i + 4 <= n; i += 4 ) {
+		__m128i* p = reinterpret_cast<__m128i*>(row + i);
+		__m128i m = _mm_loadu_si128( reinterpret_cast<const __m128i*>(mask + i) );
+		_mm_storeu_si128( p, _mm_or_si128( _mm_and_si128( _mm_loadu_si128(p), m ),
+						   _mm_andnot_si128( m, t ) ) );
+	}
+	mask_scalar( row + i, mask + i, n - i, tint );
+}
+
+__attribute__((target("sse2")))
+bool remap_sse2( uint32_t* row, size_t n, uint32_t match, uint32_t if_equal, uint32_t if_different )
+{
+	const __m128i m = _mm_set1_epi32( match );
+	const __m128i e = _mm_set1_epi32( if_equal );
+	const __m128i d = _mm_set1_epi32( if_different );
+	int all_equal = 0xFFFF;
+	size_t i = 0;
+	for( ; i + 4 <= n; i += 4 ) {
+		__m128i* p = reinterpret_cast<__m128i*>(row + i);
+		__m128i equal = _mm_cmpeq_epi32( _mm_loadu_si128(p), m );
+		all_equal &= _mm_movemask_epi8( equal );
+		_mm_storeu_si128( p, _mm_or_si128( _mm_and_si128( equal, e ),
+						   _mm_andnot_si128( equal, d ) ) );
+	}
+	bool different = remap_scalar( row + i, n - i, match, if_equal, if_different );
+	return different || all_equal != 0xFFFF;
+}
+
+// x86 is little-endian, pixel j of a word is bit j
+__attribute__((target("sse2")))
+void expand_bits_sse2( uint32_t* row, const uint32_t* bits, size_t n, uint32_t value )
+{
+	const __m128i v = _mm_set1_epi32( value );
+	const __m128i select = _mm_setr_epi32( 1, 2, 4, 8 );
+	size_t i = 0;
+	for( ; i + 32 <= n; i += 32 ) {
+		uint32_t word = bits[i / 32];
+		if( !word )
+			continue;
+		for( int j = 0; j < 32; j += 4 ) {
+			__m128i* p = reinterpret_cast<__m128i*>(row + i + j);
+			__m128i set = _mm_cmpeq_epi32( _mm_and_si128( _mm_set1_epi32( word >> j ), select ), select );
+			_mm_storeu_si128( p, _mm_or_si128( _mm_andnot_si128( set, _mm_loadu_si128(p) ),
+							   _mm_and_si128( set, v ) ) );
+		}
+	}
+	expand_bits_scalar( row + i, bits + i / 32, n - i, value );
+}
+
+__attribute__((target("avx2")))
+void fill_avx2( uint32_t* row, size_t n, uint32_t value )
+{
+	const __m256i v = _mm256_set1_epi32( value );
+	size_t i = 0;
+	for( ; i + 8 <= n; i += 8 )
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>(row + i), v );
+	fill_scalar( row + i, n - i, value );
+}
+
+__attribute__((target("avx2")))
+void set_bits_avx2( uint32_t* row, size_t n, uint32_t bits )
+{
+	const __m256i b = _mm256_set1_epi32( bits );
+	size_t i = 0;
+	for( ; i + 8 <= n; i += 8 ) {
+		__m256i* p = reinterpret_cast<__m256i*>(row + i);
+		_mm256_storeu_si256( p, _mm256_or_si256( _mm256_loadu_si256(p), b ) );
+	}
+	set_bits_scalar( row + i, n - i, bits );
+}
+
+__attribute__((target("avx2")))
+void mask_avx2( uint32_t* row, const uint32_t* mask, size_t n, uint32_t tint )
+{
+	const __m256i t = _mm256_set1_epi32( tint );
+	size_t i = 0;
+	for( ; i + 8 <= n; i += 8 ) {
+		__m256i* p = reinterpret_cast<__m256i*>(row + i);
+		__m256i m = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(mask + i) );
+		_mm256_storeu_si256( p, _mm256_or_si256( _mm256_and_si256( _mm256_loadu_si256(p), m ),
+							 _mm256_andnot_si256( m, t ) ) );
+	}
+	mask_scalar( row + i, mask + i, n - i, tint );
+}
+
+__attribute__((target("avx2")))
+bool remap_avx2( uint32_t* row, size_t n, uint32_t match, uint32_t if_equal, uint32_t if_different )
+{
+	const __m256i m = _mm256_set1_epi32( match );
+	const __m256i e = _mm256_set1_epi32( if_equal );
+	const __m256i d = _mm256_set1_epi32( if_different );
+	int all_equal = -1;
+	size_t i = 0;
+	for( ; i + 8 <= n; i += 8 ) {
+		__m256i* p = reinterpret_cast<__m256i*>(row + i);
+		__m256i equal = _mm256_cmpeq_epi32( _mm256_loadu_si256(p), m );
+		all_equal &= _mm256_movemask_epi8( equal );
+		_mm256_storeu_si256( p, _mm256_or_si256( _mm256_and_si256( equal, e ),
+							 _mm256_andnot_si256( equal, d ) ) );
+	}
+	bool different = remap_scalar( row + i, n - i, match, if_equal, if_different );
+	return different || all_equal != -1;
+}
+
+__attribute__((target("avx2")))
+void expand_bits_avx2( uint32_t* row, const uint32_t* bits, size_t n, uint32_t value )
+{
+	const __m256i v = _mm256_set1_epi32( value );
+	const __m256i select = _mm256_setr_epi32( 1, 2, 4, 8, 16, 32, 64, 128 );
+	size_t i = 0;
+	for( ; i + 32 <= n; i += 32 ) {
+		uint32_t word = bits[i / 32];
+		if( !word )
+			continue;
+		for( int j = 0; j < 32; j += 8 ) {
+			__m256i set = _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( word >> j ), select ), select );
+			_mm256_maskstore_epi32( reinterpret_cast<int*>(row + i + j), set, v );
+		}
+	}
+	expand_bits_scalar( row + i, bits + i / 32, n - i, value );
+}
+
+#endif // RASTEROPS_X86
+
+//! the kernels in use
+struct kernels
+{
+	kernels() {
+		name = "scalar";
+		fill = fill_scalar;
+		set_bits = set_bits_scalar;
+		mask = mask_scalar;
+		remap = remap_scalar;
+		expand_bits = expand_bits_scalar;
+
+#ifdef RASTEROPS_X86
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports("avx2") ) {
+			name = "avx2";
+			fill = fill_avx2;
+			set_bits = set_bits_avx2;
+			mask = mask_avx2;
+			remap = remap_avx2;
+			expand_bits = expand_bits_avx2;
+		} else if( __builtin_cpu_supports("sse2") ) {
+			name = "sse2";
+			fill = fill_sse2;
+			set_bits = set_bits_sse2;
+			mask = mask_sse2;
+			remap = remap_sse2;
+			expand_bits = expand_bits_sse2;
+		}
+#endif
+	}
+
+	const char* name;
+	void (*fill)( uint32_t*, size_t, uint32_t );
+	void (*set_bits)( uint32_t*, size_t, uint32_t );
+	void (*mask)( uint32_t*, const uint32_t*, size_t, uint32_t );
+	bool (*remap)( uint32_t*, size_t, uint32_t, uint32_t, uint32_t );
+	void (*expand_bits)( uint32_t*, const uint32_t*, size_t, uint32_t );
+};
+
+const kernels& active()
+{
+	static const kernels instance;
+	return instance;
+}
+
+}
+
+void fill( uint32_t* row, size_t n, uint32_t value )
+{
+	active().fill( row, n, value );
+}
+
+void set_bits( uint32_t* row, size_t n, uint32_t bits )
+{
+	active().set_bits( row, n, bits );
+}
+
+void mask( uint32_t* row, const uint32_t* mask, size_t n, uint32_t tint )
+{
+	active().mask( row, mask, n, tint );
+}
+
+bool remap( uint32_t* row, size_t n, uint32_t match, uint32_t if_equal, uint32_t if_different )
+{
+	return active().remap( row, n, match, if_equal, if_different );
+}
+
+void expand_bits( uint32_t* row, const uint32_t* bits, size_t n, uint32_t value )
+{
+	active().expand_bits( row, bits, n, value );
+}
+
+const char* implementation()
+{
+	return active().name;
+}
+
+}
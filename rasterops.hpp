@@ -0,0 +1,58 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RASTEROPS_H
+#define RASTEROPS_H
+
+#include <stdint.h>
+#include <cstddef>
+
+/*! Row kernels for the passes of Surface that touch every pixel.
+ *  Each works on n consecutive ARGB32 pixels; there are SSE2 and AVX2
+ *  versions, chosen on the first use by what the processor supports,
+ *  and a plain one for everything else.
+ */
+namespace rasterops
+{
+	//! sets every pixel to value
+	void fill( uint32_t* row, size_t n, uint32_t value );
+
+	//! ors bits into every pixel
+	void set_bits( uint32_t* row, size_t n, uint32_t bits );
+
+	//! row = (row & mask) | (~mask & tint)
+	void mask( uint32_t* row, const uint32_t* mask, size_t n, uint32_t tint );
+
+	//! pixels equal to match become if_equal, all others if_different
+	/*! \return true if any pixel was different from match
+	 */
+	bool remap( uint32_t* row, size_t n, uint32_t match, uint32_t if_equal, uint32_t if_different );
+
+	//! pixels whose bit is set become value, the others stay
+	/*! bits is a row of a Cairo::FORMAT_A1 surface: pixel i of a word is
+	 *  bit i on little-endian machines and bit 31 - i on big-endian ones.
+	 *  Words without set bits are skipped.
+	 */
+	void expand_bits( uint32_t* row, const uint32_t* bits, size_t n, uint32_t value );
+
+	//! "avx2", "sse2" or "scalar", whichever is used
+	const char* implementation();
+}
+
+#endif // RASTEROPS_H
@@ -19,6 +19,8 @@
 
 #include "smooth_ngc_exporter.hpp"
 #include "douglas_peucker.hpp"
+#include "export_pipeline.hpp"
+#include "output_file.hpp"
 
 #include <boost/foreach.hpp>
 
@@ -32,30 +34,50 @@ SNGC_Exporter::SNGC_Exporter( shared_ptr<Board> board ) : NGC_Exporter(board)
 	bDoSVG = false;
 }
 
+//! hands the toolpaths to the Gcode smoother
+class SNGC_Sink
+{
+public:
+	SNGC_Sink( Gcode& gc, shared_ptr<RoutingMill> mill ) : gc(gc), mill(mill) {}
+
+	void begin_contour( double x, double y )
+	{
+		// retract, move to the starting point of the next contour
+		gc.safety();
+		gc.rapid(Move().X(x).Y(y));
+	}
+
+	void begin_pass( double z )
+	{
+		gc.set_feed(mill->feed);
+		gc.cut(Move().Z(z));
+	}
+
+	void point( double x, double y )
+	{
+		gc.cut(Move().X(x).Y(y));
+	}
+
+	void end_pass() {}
+	void end_contour() {}
+
+private:
+	Gcode& gc;
+	shared_ptr<RoutingMill> mill;
+};
+
 void
 SNGC_Exporter::export_layer( shared_ptr<Layer> layer, string of_name )
 {
-	string layername = layer->get_name();
 	shared_ptr<RoutingMill> mill = layer->get_manufacturer();
 
-	bool bSvgOnce = TRUE;
-	
 	// open output file
-	std::ofstream of; of.open( of_name.c_str() );
+	OutputFile of( of_name );
 
     // create Gcode D-P filter
     Gcode gc(mill->zchange, mill->zsafe, get_tolerance(), mill->speed, "G20", of);
 
-	// write header to .ngc file
-        BOOST_FOREACH( string s, header )
-        {
-                of << "( " << s << " )" << endl;
-        }
-        of << endl;
-
-        of.setf( ios_base::fixed );
-        of.precision(5);
-	of << setw(7);
+	write_header( of );
 
 	// preamble
 	of << "G94     ( Inches per minute feed rate. )\n"
@@ -68,126 +90,27 @@ SNGC_Exporter::export_layer( shared_ptr<Layer> layer, string of_name )
 	of << "G64 P" << get_tolerance() << " ( set maximum deviation from commanded toolpath )\n"
 	   << endl;
 
-	
 	//SVG EXPORTER
 	if (bDoSVG) {
 		//choose a color
 		svgexpo->set_rand_color();
 	}
-	
-	
-	// contours
- 	BOOST_FOREACH( shared_ptr<icoords> path, layer->get_toolpaths() )
-        {
-		// retract, move to the starting point of the next contour
-//		of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-        gc.safety();
-        gc.rapid(Move().X(path->begin()->first).Y(path->begin()->second));
-			
-		//SVG EXPORTER
-		if (bDoSVG) {						
-			svgexpo->move_to(path->begin()->first, path->begin()->second);
-			bSvgOnce = TRUE;
-		}
-			
-		/** if we're cutting, perhaps do it in multiple steps, but do isolations just once.
-		 *  i know this is partially repetitive, but this way it's easier to read
-		 */
-		shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>( mill );
-		if( cutter && cutter->do_steps ) {
-			// cutting
-			double z_step = cutter->stepsize;
-			double z = mill->zwork + z_step * abs( int( mill->zwork / z_step ) );
-
-			while( z >= mill->zwork ) {
-                gc.set_feed(mill->feed);
-                gc.cut(Move().Z(z));
-//				of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-
-				icoords::iterator iter = path->begin();
-				icoords::iterator last = path->end(); // initializing to quick & dirty sentinel value
-				icoords::iterator peek;
-				while( iter != path->end() ) {
-					peek = iter + 1;
-					if( /* it's necessary to write the coordinates if... */
-							last == path->end() || /* it's the beginning */
-							peek == path->end() || /* it's the end */
-							!( /* or if neither of the axis align */
-								( last->first == iter->first && iter->first == peek->first ) || /* x axis aligns */
-								( last->second == iter->second && iter->second == peek->second ) /* y axis aligns */
-							)
-							/* no need to check for "they are on one axis but iter is outside of last and peek" becaus that's impossible from how they are generated */
-					  ) {
-                        gc.cut(Move().X(iter->first).Y(iter->second));
-						
-						//SVG EXPORTER
-						if (bDoSVG) {
-							if (bSvgOnce) svgexpo->line_to(iter->first, iter->second);
-						}
-					}
-					last = iter;
-					++iter;
-				}
-				//SVG EXPORTER
-				if (bDoSVG) {
-					svgexpo->close_path();
-					bSvgOnce = FALSE;
-				}
-			
-				z -= z_step;
-			}
-		} else {
-			// isolating
-            gc.set_feed(mill->feed);
-            gc.cut(Move().Z(mill->zwork));
-//			of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-
-			icoords::iterator iter = path->begin();
-			icoords::iterator last = path->end(); // initializing to quick & dirty sentinel value
-			icoords::iterator peek;
-			while( iter != path->end() ) {
-				peek = iter + 1;
-				if( /* it's necessary to write the coordinates if... */
-						last == path->end() || /* it's the beginning */
-						peek == path->end() || /* it's the end */
-						!( /* or if neither of the axis align */
-							( last->first == iter->first && iter->first == peek->first ) || /* x axis aligns */
-							( last->second == iter->second && iter->second == peek->second ) /* y axis aligns */
-						)
-						/* no need to check for "they are on one axis but iter is outside of last and peek" becaus that's impossible from how they are generated */
-				  ) {
-                    gc.cut(Move().X(iter->first).Y(iter->second));
-					
-					//SVG EXPORTER
-					if (bDoSVG) if (bSvgOnce) svgexpo->line_to(iter->first, iter->second);
-
-				}
-				last = iter;
-				++iter;
-			}
-			//SVG EXPORTER
-			if (bDoSVG) {
-				svgexpo->close_path();
-				bSvgOnce = FALSE;
-			}
-
-		}
-
-
-		
-        }
 
+	// contours
+	if( planner )
+		planner->begin_output( layer->get_name() );
+	SNGC_Sink sink( gc, mill );
+	pipeline::export_toolpaths( layer->get_toolpaths(), mill,
+				    bDoSVG ? svgexpo : shared_ptr<SVG_Exporter>(), planner, sink );
+
+        // the cuts of the last contour are still buffered and follow the blank line
+        gc.write();
         of << endl;
 
 	// retract, end
-//	of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-//	of << "G00 Z" << mill->zchange << " ( retract )\n" << endl;
     gc.safety();
     gc.end();
 
-//	of << "M9 ( Coolant off. )\n";
-//	of << "M2 ( Program end. )\n\n";
-
 	of.close();
 	
 	//SVG EXPORTER
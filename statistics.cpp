@@ -0,0 +1,308 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "statistics.hpp"
+#include "export_pipeline.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/foreach.hpp>
+
+//! follows the tool and adds its moves to an output_statistics
+class Motion
+{
+public:
+	Motion( output_statistics& stats, const machine_limits& limits, double x, double y, double z )
+		: stats(stats), limits(limits), x(x), y(y), z(z) {}
+
+	void rapid( double to_x, double to_y, double to_z )
+	{
+		double length = distance( to_x, to_y, to_z );
+		stats.rapid_length += length;
+		stats.seconds += JobStatistics::move_time( length, limits.rapid_feed, limits.acceleration );
+	}
+
+	void cut( double to_x, double to_y, double to_z, double feed )
+	{
+		bool plunge = to_x == x && to_y == y;
+		double length = distance( to_x, to_y, to_z );
+		( plunge ? stats.plunge_length : stats.cut_length ) += length;
+		stats.seconds += JobStatistics::move_time( length, std::min( feed, limits.rapid_feed ), limits.acceleration );
+	}
+
+	//! a cut whose time is added separately
+	void cut_untimed( double to_x, double to_y )
+	{
+		stats.cut_length += distance( to_x, to_y, z );
+	}
+
+	//! a full circle around the current position at the given radius,
+	//! starting and ending at the current position
+	void circle( double radius, double feed )
+	{
+		double length = 2 * M_PI * radius;
+		stats.cut_length += length;
+		stats.seconds += JobStatistics::move_time( length, std::min( feed, limits.rapid_feed ), limits.acceleration );
+	}
+
+	double get_x() const { return x; };
+	double get_y() const { return y; };
+	double get_z() const { return z; };
+
+private:
+	double distance( double to_x, double to_y, double to_z )
+	{
+		double dx = to_x - x, dy = to_y - y, dz = to_z - z;
+		x = to_x;
+		y = to_y;
+		z = to_z;
+		return sqrt( dx * dx + dy * dy + dz * dz );
+	}
+
+	output_statistics& stats;
+	const machine_limits& limits;
+	double x, y, z;
+};
+
+//! the end of the export pipeline, making the moves NGC_Sink writes
+/*! With a planner the points of every pass are collected and the pass is
+ *  timed as a whole, like the FeedPlanner does.
+ */
+class StatisticsSink
+{
+public:
+	StatisticsSink( Motion& motion, output_statistics& stats, shared_ptr<RoutingMill> mill,
+			shared_ptr<FeedPlanner> planner, double feed )
+		: motion(motion), stats(stats), mill(mill), planner(planner), feed(feed) {}
+
+	void begin_contour( double x, double y )
+	{
+		motion.rapid( motion.get_x(), motion.get_y(), mill->zsafe );
+		motion.rapid( x, y, mill->zsafe );
+	}
+
+	void begin_pass( double z )
+	{
+		motion.cut( motion.get_x(), motion.get_y(), z, mill->feed );
+		stats.plunges++;
+		xs.clear();
+		ys.clear();
+	}
+
+	void point( double x, double y )
+	{
+		if( planner ) {
+			motion.cut_untimed( x, y );
+			xs.push_back( x );
+			ys.push_back( y );
+		} else {
+			motion.cut( x, y, motion.get_z(), mill->feed );
+		}
+	}
+
+	void end_pass()
+	{
+		if( planner )
+			stats.seconds += planner->planned_time( xs, ys, feed );
+	}
+
+	void end_contour() {}
+
+private:
+	Motion& motion;
+	output_statistics& stats;
+	shared_ptr<RoutingMill> mill;
+	shared_ptr<FeedPlanner> planner;
+	double feed;
+	vector<double> xs, ys;
+};
+
+static output_statistics empty_statistics( string name )
+{
+	output_statistics stats;
+	stats.name = name;
+	stats.cut_length = stats.plunge_length = stats.rapid_length = 0;
+	stats.plunges = stats.tool_changes = 0;
+	stats.seconds = 0;
+	return stats;
+}
+
+JobStatistics::JobStatistics( machine_limits limits ) : limits(limits)
+{
+	if( limits.junction_deviation > 0 )
+		planner.reset( new FeedPlanner( limits.acceleration, limits.junction_deviation ) );
+}
+
+double
+JobStatistics::move_time( double length, double speed, double acceleration )
+{
+	double v = speed / 60;
+	if( length <= 0 || v <= 0 )
+		return 0;
+	if( acceleration <= 0 )
+		return length / v;
+
+	// trapezoidal profile, or triangular if the move is too short to
+	// reach the speed
+	if( length >= v * v / acceleration )
+		return length / v + v / acceleration;
+	else
+		return 2 * sqrt( length / acceleration );
+}
+
+/* Every output starts with the tool at the origin and the tool changing
+ * height, and ends back up there.
+ */
+void
+JobStatistics::add_layer( string name, const ToolpathSet& toolpaths, shared_ptr<RoutingMill> mill )
+{
+	output_statistics stats = empty_statistics( name );
+	stats.tool_changes = 1;
+
+	Motion motion( stats, limits, 0, 0, mill->zchange );
+	StatisticsSink sink( motion, stats, mill, planner, std::min( mill->feed, limits.rapid_feed ) );
+	pipeline::plan( toolpaths, mill, planner, sink );
+	motion.rapid( motion.get_x(), motion.get_y(), mill->zchange );
+
+	outputs.push_back( stats );
+}
+
+void
+JobStatistics::add_drill( string name, const map<int,drillbit>& bits, const map<int,icoords>& holes,
+			  shared_ptr<Mill> mill )
+{
+	output_statistics stats = empty_statistics( name );
+	shared_ptr<Cutter> cutter = boost::dynamic_pointer_cast<Cutter>(mill);
+
+	Motion motion( stats, limits, 0, 0, mill->zchange );
+
+	for( map<int,drillbit>::const_iterator it = bits.begin(); it != bits.end(); it++ ) {
+		map<int,icoords>::const_iterator bit_holes = holes.find( it->first );
+		if( bit_holes == holes.end() )
+			continue;
+
+		if( !cutter ) {
+			motion.rapid( motion.get_x(), motion.get_y(), mill->zchange );
+			stats.tool_changes++;
+		}
+
+		double diameter = it->second.unit == "mm" ? it->second.diameter / 25.4 : it->second.diameter;
+
+		BOOST_FOREACH( const icoordpair& hole, bit_holes->second ) {
+			if( !cutter || cutter->tool_diameter * 1.001 >= diameter ) {
+				motion.rapid( hole.first, hole.second, motion.get_z() );
+				motion.cut( hole.first, hole.second, mill->zwork, mill->feed );
+				motion.rapid( hole.first, hole.second, mill->zsafe );
+				stats.plunges++;
+				continue;
+			}
+
+			// milled in circles, one for every infeed step
+			double radius = ( diameter - cutter->tool_diameter ) / 2;
+			motion.rapid( hole.first + radius, hole.second, motion.get_z() );
+
+			int steps = cutter->do_steps ? abs( int( cutter->zwork / cutter->stepsize ) ) : 0;
+			for( int step = steps; step >= 0; step-- ) {
+				motion.cut( motion.get_x(), motion.get_y(), cutter->zwork + step * cutter->stepsize, mill->feed );
+				motion.circle( radius, mill->feed );
+				stats.plunges++;
+			}
+			motion.rapid( motion.get_x(), motion.get_y(), mill->zsafe );
+		}
+	}
+
+	if( cutter && !holes.empty() )
+		stats.tool_changes = 1;
+	motion.rapid( motion.get_x(), motion.get_y(), mill->zchange );
+
+	outputs.push_back( stats );
+}
+
+string
+JobStatistics::format_time( double seconds )
+{
+	long total = long( seconds + 0.5 );
+	std::ostringstream time;
+	time << total / 3600 << ":" << std::setfill('0') << std::setw(2) << total / 60 % 60
+	     << ":" << std::setw(2) << total % 60;
+	return time.str();
+}
+
+void
+JobStatistics::print_summary( std::ostream& out )
+{
+	double total_seconds = 0;
+	uint total_tool_changes = 0;
+
+	out << "Machine time at " << limits.rapid_feed << " ipm rapids";
+	if( limits.acceleration > 0 )
+		out << " and " << limits.acceleration << " in/s^2";
+	if( planner )
+		out << ", cuts feed planned at " << limits.junction_deviation << "in junction deviation";
+	out << ":" << std::endl;
+
+	BOOST_FOREACH( output_statistics& s, outputs ) {
+		out << "  " << s.name << ": "
+		    << s.cut_length << "in cut, "
+		    << s.rapid_length << "in rapid, "
+		    << s.plunges << " plunges, "
+		    << s.tool_changes << " tool change(s), "
+		    << format_time( s.seconds ) << std::endl;
+		total_seconds += s.seconds;
+		total_tool_changes += s.tool_changes;
+	}
+
+	out << "Total: " << format_time( total_seconds ) << " plus "
+	    << total_tool_changes << " tool change(s)" << std::endl;
+}
+
+void
+JobStatistics::write_json( std::ostream& out )
+{
+	double total_seconds = 0;
+	uint total_tool_changes = 0;
+
+	out << "{\n"
+	    << "  \"rapid_feed_ipm\": " << limits.rapid_feed << ",\n"
+	    << "  \"acceleration_in_s2\": " << limits.acceleration << ",\n"
+	    << "  \"junction_deviation_in\": " << limits.junction_deviation << ",\n"
+	    << "  \"outputs\": [";
+
+	for( uint i = 0; i < outputs.size(); i++ ) {
+		output_statistics& s = outputs[i];
+		out << ( i ? ",\n" : "\n" )
+		    << "    { \"name\": \"" << s.name << "\""
+		    << ", \"cut_length_in\": " << s.cut_length
+		    << ", \"plunge_length_in\": " << s.plunge_length
+		    << ", \"rapid_length_in\": " << s.rapid_length
+		    << ", \"plunges\": " << s.plunges
+		    << ", \"tool_changes\": " << s.tool_changes
+		    << ", \"seconds\": " << s.seconds << " }";
+		total_seconds += s.seconds;
+		total_tool_changes += s.tool_changes;
+	}
+
+	out << "\n  ],\n"
+	    << "  \"total_seconds\": " << total_seconds << ",\n"
+	    << "  \"total_tool_changes\": " << total_tool_changes << "\n"
+	    << "}\n";
+}
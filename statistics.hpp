@@ -0,0 +1,95 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <map>
+using std::map;
+#include <ostream>
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include "coord.hpp"
+#include "drill.hpp"
+#include "feed_planner.hpp"
+#include "mill.hpp"
+#include "toolpath.hpp"
+
+//! speed limits of the machine, in inches and seconds
+struct machine_limits
+{
+	double rapid_feed;	// ipm
+	double acceleration;	// in/s^2, 0 for instant changes of speed
+	double junction_deviation;	// in, 0 unless the cuts are feed planned
+};
+
+//! the moves of one output file and the time they take
+struct output_statistics
+{
+	string name;
+	double cut_length;	// XY moves at feed
+	double plunge_length;	// Z moves at feed
+	double rapid_length;	// XY and Z moves at rapid speed
+	uint plunges;
+	uint tool_changes;
+	double seconds;
+};
+
+//! Adds up the moves of the generated G-code and estimates the run time.
+/*! The layers are run through the same export pipeline as the G-code, the
+ *  drill files go over the holes the way ExcellonProcessor does. Every move
+ *  is timed as accelerating from rest to its speed and braking to rest
+ *  again, as a controller without look-ahead would; machines that blend the
+ *  moves get done sooner. With a junction deviation the layers also go
+ *  through the feed planning, and the cutting passes are timed the way the
+ *  FeedPlanner plans them. Tool changes are counted, not timed.
+ */
+class JobStatistics
+{
+public:
+	JobStatistics( machine_limits limits );
+
+	void add_layer( string name, const ToolpathSet& toolpaths, shared_ptr<RoutingMill> mill );
+	//! with a Cutter the holes are milled like with --milldrill
+	void add_drill( string name, const map<int,drillbit>& bits, const map<int,icoords>& holes,
+			shared_ptr<Mill> mill );
+
+	bool empty() const { return outputs.empty(); };
+
+	void print_summary( std::ostream& out );
+	void write_json( std::ostream& out );
+
+	//! seconds for a move from rest to rest, speed in ipm
+	static double move_time( double length, double speed, double acceleration );
+	//! hours:minutes:seconds
+	static string format_time( double seconds );
+
+private:
+	machine_limits limits;
+	shared_ptr<FeedPlanner> planner;	// kept apart from the printed one
+	vector<output_statistics> outputs;
+};
+
+#endif // STATISTICS_H
@@ -18,6 +18,16 @@
  */
 
 #include "surface.hpp"
+#include "rasterops.hpp"
+#include "chaincode.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <string>
+using std::string;
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 using std::pair;
 
 // color definitions for the ARGB32 format used
@@ -29,6 +39,9 @@ using std::pair;
 #define WHITE ( RED | GREEN | BLUE )
 // while equal by value, OPAQUE is used for |-ing and BLACK for setting or comparison
 #define BLACK ( RED & GREEN & BLUE )
+// the frame around every surface; like the area outside a mask, it blocks
+// growing, so components never reach it and neighbour probes stay inside
+#define SENTINEL ( RED | BLUE )
 
 void Surface::make_the_surface(uint width, uint height)
 {
@@ -47,9 +60,15 @@ using std::endl;
 
 #define PRC(x) *(reinterpret_cast<guint32*>(x))
 
+// the pixels of line y, for the rasterops kernels
+static inline uint32_t* row( guint8* pixels, int stride, int y )
+{
+	return reinterpret_cast<uint32_t*>( pixels + y*stride );
+}
+
 Surface::Surface( guint dpi, ivalue_t min_x, ivalue_t max_x, ivalue_t min_y, ivalue_t max_y )
 	: dpi(dpi), min_x(min_x), max_x(max_x), min_y(min_y), max_y(max_y),
-	  zero_x(-min_x*(ivalue_t)dpi + (ivalue_t)procmargin), zero_y(-min_y*(ivalue_t)dpi + (ivalue_t)procmargin), clr(32)
+	  zero_x(-min_x*(ivalue_t)dpi + (ivalue_t)procmargin), zero_y(-min_y*(ivalue_t)dpi + (ivalue_t)procmargin), clr(32), marching_squares(false), blasts(0)
 {
 	guint8* pixels;
 	int stride;
@@ -58,22 +77,87 @@ Surface::Surface( guint dpi, ivalue_t min_x, ivalue_t max_x, ivalue_t min_y, iva
 	usedcolors.push_back(WHITE);
 
 	/* "Note that the buffer is not cleared; you will have to fill it completely yourself." */
-	printf("clearing\n");
+	LOG(LOG_DEBUG) << "clearing" << endl;
         pixels = cairo_surface->get_data();
         stride = cairo_surface->get_stride();
         for(int y = 0; y < pixbuf->get_height(); y++ )
-        {
-                for(int x = 0; x < pixbuf->get_width(); x++ )
-                {
-                        PRC(pixels + x*4 + y*stride) = BLACK;
-                }
-        }
+                rasterops::fill( row(pixels, stride, y), pixbuf->get_width(), BLACK );
+
+	draw_sentinel();
+}
+
+void Surface::draw_sentinel()
+{
+	guint8* pixels = cairo_surface->get_data();
+	int stride = cairo_surface->get_stride();
+	int width = cairo_surface->get_width();
+	int height = cairo_surface->get_height();
+
+	for(int x = 0; x < width; x++ )
+	{
+		PRC(pixels + x*4) = SENTINEL;
+		PRC(pixels + x*4 + (height - 1)*stride) = SENTINEL;
+	}
+	for(int y = 0; y < height; y++ )
+	{
+		PRC(pixels + y*stride) = SENTINEL;
+		PRC(pixels + (width - 1)*4 + y*stride) = SENTINEL;
+	}
+}
+
+size_t Surface::get_memory_footprint( guint dpi, ivalue_t width, ivalue_t height )
+{
+	// same dimensions as in the constructor, 4 bytes per ARGB32 pixel and
+	// the bitmap, whose lines are padded to 32 pixels
+	uint w = width * dpi + 2*procmargin;
+	uint h = height * dpi + 2*procmargin;
+	return size_t(w) * h * 4 + size_t( (w + 31) / 32 * 4 ) * h;
 }
 
+/* The layer is rendered into the bitmap, and only its set bits are written
+ * into the black label raster. fill_all_components skips the empty words of
+ * the bitmap when it looks for the components.
+ */
 void Surface::render( boost::shared_ptr<LayerImporter> importer ) throw(import_exception)
 {
-	importer->render(cairo_surface, dpi, min_x - static_cast<ivalue_t>(procmargin)/dpi,
-			 min_y - static_cast<ivalue_t>(procmargin)/dpi );
+	int width = cairo_surface->get_width();
+	int height = cairo_surface->get_height();
+	ivalue_t xoff = min_x - static_cast<ivalue_t>(procmargin)/dpi;
+	ivalue_t yoff = min_y - static_cast<ivalue_t>(procmargin)/dpi;
+
+	bitmap = Cairo::ImageSurface::create( Cairo::FORMAT_A1, width, height );
+	importer->render_bitmap( bitmap, dpi, xoff, yoff );
+	bitmap->flush();
+
+	guint8* pixels = cairo_surface->get_data();
+	int stride = cairo_surface->get_stride();
+	const guint8* bits = bitmap->get_data();
+	int bits_stride = bitmap->get_stride();
+
+	for(int y = 0; y < height; y++ )
+		rasterops::expand_bits( row(pixels, stride, y),
+					reinterpret_cast<const uint32_t*>(bits + y*bits_stride), width, WHITE );
+	cairo_surface->mark_dirty();
+
+	// --enable-debug-log: count the pixels an ARGB32 rendering would have
+	// coloured differently
+	if( LOG_MAX_LEVEL >= LOG_DEBUG ) {
+		Cairo::RefPtr<Cairo::ImageSurface> argb = Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32, width, height );
+		importer->render( argb, dpi, xoff, yoff );
+		argb->flush();
+
+		guint8* argb_pixels = argb->get_data();
+		int argb_stride = argb->get_stride();
+		size_t different = 0;
+		for(int y = 0; y < height; y++ )
+			for(int x = 0; x < width; x++ )
+				different += ( (PRC(argb_pixels + x*4 + y*argb_stride) | OPAQUE) == WHITE )
+					     != ( PRC(pixels + x*4 + y*stride) == WHITE );
+
+		LOG(LOG_DEBUG) << "render: " << different << " pixel(s) differ from the ARGB32 rendering" << endl;
+	}
+
+	draw_sentinel();
 }
 
 #include <iostream>
@@ -148,8 +232,31 @@ void simplifypath(shared_ptr<icoords> outline, double accuracy)
 }
 
 
-vector< shared_ptr<icoords> >
-Surface::get_toolpath( shared_ptr<RoutingMill> mill, bool mirrored, bool mirror_absolute )
+//! the outlines of all components after a growing step
+struct Surface::trace_pass
+{
+	trace_pass( const coords& components )
+		: components(components), next(0),
+		  chains( components.size(), ChainCode(0, 0) ), contours( components.size() ),
+		  untraced( components.size(), 0 ), errors( components.size() ) {}
+
+	const coords& components;
+	vector<size_t> order;		// largest components first
+	size_t next;			// position in order of the next job
+	boost::mutex mutex;
+
+	// results by component
+	vector<ChainCode> chains;
+	vector<icoords> contours;	// if marching squares are used
+	vector<char> untraced;		// left for tracing with repair (not
+					// vector<bool>, whose bits share bytes)
+	vector<string> errors;
+};
+
+uint Surface::tracing_threads = boost::thread::hardware_concurrency();
+
+void
+Surface::get_toolpath( shared_ptr<RoutingMill> mill, bool mirrored, bool mirror_absolute, ToolpathSet& toolpath )
 {
 	Isolator* iso = dynamic_cast<Isolator*>(mill.get());
 	int extra_passes = iso?iso->extra_passes:0;
@@ -161,11 +268,17 @@ Surface::get_toolpath( shared_ptr<RoutingMill> mill, bool mirrored, bool mirror_
 	int grow = mill->tool_diameter / 2 * dpi;
 	ivalue_t double_mirror_axis = mirror_absolute ? 0 : (min_x + max_x);
 
-	vector< shared_ptr<icoords> > toolpath;
+	toolpath.clear();
 
 	for( int pass = 0; pass <= extra_passes && added != 0; pass++ )
 	{
-		for(int i = 0; i < grow && added != 0; i++)
+		// the contours of marching squares run on the border of the grown
+		// area rather than half a pixel outside of it like the outlines, so
+		// the area is grown by one more pixel for them. that pixel stays for
+		// the extra passes, which grow on from here.
+		int steps = grow + ( marching_squares && pass == 0 ? 1 : 0 );
+
+		for(int i = 0; i < steps && added != 0; i++)
 		{
 			added = 0;
 
@@ -174,38 +287,114 @@ Surface::get_toolpath( shared_ptr<RoutingMill> mill, bool mirrored, bool mirror_
 			}
 		}
 
-		coords inside, outside;
+		trace_pass traced( components );
+		trace_components( traced );
 
-		BOOST_FOREACH( coordpair c, components ) {
-			calculate_outline( c.first, c.second, outside, inside );
-			inside.clear();
+		for( size_t i = 0; i < components.size(); i++ ) {
+			toolpath.begin_contour( true, pass );
 
-			shared_ptr<icoords> outline( new icoords() );
+			if( marching_squares ) {
+				BOOST_FOREACH( icoordpair p, traced.contours[i] ) {
+					toolpath.add_point( mirrored ? (double_mirror_axis - xpt2i(p.first)) : xpt2i(p.first),
+							    min_y + max_y - ypt2i(p.second) );
+				}
 
-			// i'm not sure wheter this is the right place to do this...
-			// that "mirrored" flag probably is a bad idea.
-			BOOST_FOREACH( coordpair c, outside ) {
-				outline->push_back( icoordpair(
-							    // tricky calculations
-							    mirrored ? (double_mirror_axis - xpt2i(c.first)) : xpt2i(c.first),
-							    min_y + max_y - ypt2i(c.second) ) );
+				continue;
 			}
 
-			if(0) simplifypath(outline,0.005);
-			outside.clear();
-			toolpath.push_back(outline);
+			// only the corners of the chain are turned into inches; the
+			// pixels of straight and diagonal runs are never converted.
+			// i'm not sure wheter this is the right place to do this...
+			// that "mirrored" flag probably is a bad idea.
+			traced.chains[i].decode( toolpath,
+						 mirrored ? -1 / ivalue_t(dpi) : 1 / ivalue_t(dpi),
+						 mirrored ? double_mirror_axis + zero_x / ivalue_t(dpi) : -zero_x / ivalue_t(dpi),
+						 -1 / ivalue_t(dpi), min_y + max_y + zero_y / ivalue_t(dpi) );
 		}
 	}
 
 	if(contentions) {
-		cerr << "Warning: pcb2gcode hasn't been able to fulfill all"
-		     << " clearance requirements and tried a best effort approach"
-		     << " instead. You may want to check the g-code output and"
-		     << " possibly use a smaller milling width.\n";
+		LOG(LOG_WARNING) << "Warning: pcb2gcode hasn't been able to fulfill all"
+				 << " clearance requirements and tried a best effort approach"
+				 << " instead. You may want to check the g-code output and"
+				 << " possibly use a smaller milling width.\n";
 	}
 
 	save_debug_image("traced");
-	return toolpath;
+}
+
+// compares component indices by component size, descending
+struct larger_component
+{
+	larger_component( const vector<uint>& sizes ) : sizes(sizes) {}
+	bool operator()( size_t a, size_t b ) const { return sizes[a] > sizes[b]; }
+	const vector<uint>& sizes;
+};
+
+/* Traces the components concurrently. The tracers only read the surface,
+ * and each component gets its own result slot, so the results come out the
+ * same regardless of the number of threads. The largest components are
+ * handed out first so that no thread is left with a big one at the end.
+ * Components with stray pixels are traced again afterwards with repair,
+ * which changes pixels and therefore runs alone.
+ */
+void Surface::trace_components( trace_pass& pass )
+{
+	for( size_t i = 0; i < pass.components.size(); i++ )
+		pass.order.push_back(i);
+	std::stable_sort( pass.order.begin(), pass.order.end(), larger_component(component_sizes) );
+
+	uint threads = std::min<size_t>( std::max(tracing_threads, 1U), pass.components.size() );
+	if( threads <= 1 ) {
+		trace_worker( &pass );
+	} else {
+		boost::thread_group pool;
+		for( uint i = 0; i < threads; i++ )
+			pool.create_thread( boost::bind( &Surface::trace_worker, this, &pass ) );
+		pool.join_all();
+	}
+
+	for( size_t i = 0; i < pass.components.size(); i++ ) {
+		if( !pass.errors[i].empty() )
+			throw std::logic_error( pass.errors[i] );
+
+		if( pass.untraced[i] ) {
+			coords outside, inside;
+			calculate_outline( pass.components[i].first, pass.components[i].second, outside, inside );
+			pass.chains[i] = ChainCode( outside );
+		}
+	}
+}
+
+void Surface::trace_worker( trace_pass* pass )
+{
+	coords outside, inside;
+
+	while( true ) {
+		size_t index;
+		{
+			boost::mutex::scoped_lock lock( pass->mutex );
+			if( pass->next >= pass->order.size() )
+				return;
+			index = pass->order[pass->next++];
+		}
+
+		const coordpair& c = pass->components[index];
+		try {
+			if( marching_squares ) {
+				calculate_contour( c.first, c.second, pass->contours[index] );
+			} else if( calculate_outline( c.first, c.second, outside, inside, false ) ) {
+				pass->chains[index] = ChainCode( outside );
+			} else {
+				pass->untraced[index] = 1;
+			}
+		} catch( std::exception& e ) {
+			pass->errors[index] = e.what();
+		}
+
+		outside.clear();
+		inside.clear();
+	}
 }
 
 guint32 Surface::get_an_unused_color()
@@ -234,38 +423,58 @@ guint32 Surface::get_an_unused_color()
 std::vector< std::pair<int,int> > Surface::fill_all_components()
 {
 	std::vector< pair<int,int> > components;
+	component_sizes.clear();
 	int max_x = cairo_surface->get_width() - 1;
 	int max_y = cairo_surface->get_height() - 1;
 	guint8* pixels = cairo_surface->get_data();
 	int stride = cairo_surface->get_stride();
 
+	// white pixels only remain where render set bits; the mask may have
+	// tinted some of them since, but never made new ones white
+	const guint8* bits = bitmap ? bitmap->get_data() : NULL;
+	int bits_stride = bitmap ? bitmap->get_stride() : 0;
+
 	for(int y = 0; y <= max_y; y ++)
 	{
-		for(int x = 0; x <= max_x; x ++)
+		const uint32_t* words = bits ? reinterpret_cast<const uint32_t*>(bits + y*bits_stride) : NULL;
+
+		// 32 pixels at a time, skipping those without a set bit
+		for(int left = 0; left <= max_x; left += 32)
 		{
-			if( (PRC(pixels + x*4 + y*stride) | OPAQUE) == WHITE )
+			if( words && !words[left / 32] )
+				continue;
+
+			int right = std::min( left + 31, max_x );
+			for(int x = left; x <= right; x ++)
 			{
-				components.push_back( pair<int,int>(x,y) );
-				fill_a_component(x, y, get_an_unused_color());
+				if( (PRC(pixels + x*4 + y*stride) | OPAQUE) == WHITE )
+				{
+					components.push_back( pair<int,int>(x,y) );
+					component_sizes.push_back( fill_a_component(x, y, get_an_unused_color()) );
+				}
 			}
 		}
 	}
 
+	// the components have their colours now, the bitmap is of no use any more
+	bitmap.clear();
+
 	return components;
 }
 
 #include <stack>
 
-// fill_a_component does not do any image boundary checks out of performance reasons.
-void Surface::fill_a_component(int x, int y, guint32 argb)
+// fill_a_component does not do any image boundary checks, the sentinel frame
+// stops it. returns the number of pixels filled.
+uint Surface::fill_a_component(int x, int y, guint32 argb)
 {
+	uint filled = 0;
 	guint32 newclr = argb;
 
 	guint8* pixels = cairo_surface->get_data();
 	int stride = cairo_surface->get_stride();
 
 	guint8* here = pixels + x*4 + y*stride;
-	guint8* maxhere = pixels + (cairo_surface->get_width()-1)*4 + (cairo_surface->get_height()-1)*stride;
 
 	guint32 ownclr = PRC(here);
 
@@ -280,27 +489,31 @@ void Surface::fill_a_component(int x, int y, guint32 argb)
 		queued_pixels.pop();
 
 		here = pixels + x*4 + y*stride;
+		if( PRC(here) == newclr )
+			continue;	// queued more than once
 		PRC(here) = newclr;
+		filled++;
 
-		if( here+4 <= maxhere && PRC(here+4) == ownclr )
+		if( PRC(here+4) == ownclr )
 			queued_pixels.push( pair<int,int>(x+1, y) );
-		if( pixels <= here-4 && PRC(here-4) == ownclr )
+		if( PRC(here-4) == ownclr )
 			queued_pixels.push( pair<int,int>(x-1, y) );
-		if( here+stride <= maxhere && PRC(here+stride) == ownclr )
+		if( PRC(here+stride) == ownclr )
 			queued_pixels.push( pair<int,int>(x, y+1) );
-		if( pixels <= here-stride && PRC(here-stride) == ownclr )
+		if( PRC(here-stride) == ownclr )
 			queued_pixels.push( pair<int,int>(x, y-1) );
-		if( here+4+stride <= maxhere && PRC(here+4+stride) == ownclr )
+		if( PRC(here+4+stride) == ownclr )
 			queued_pixels.push( pair<int,int>(x+1, y+1) );
-		if( here-4+stride <= maxhere && PRC(here-4+stride) == ownclr )
+		if( PRC(here-4+stride) == ownclr )
 			queued_pixels.push( pair<int,int>(x-1, y+1) );
-		if( pixels <= here+4-stride && PRC(here+4-stride) == ownclr )
+		if( PRC(here+4-stride) == ownclr )
 			queued_pixels.push( pair<int,int>(x+1, y-1) );
-		if( pixels <= here-4-stride && PRC(here-4-stride) == ownclr )
+		if( PRC(here-4-stride) == ownclr )
 			queued_pixels.push( pair<int,int>(x-1, y-1) );
 	}
 
 	cairo_surface->mark_dirty();
+	return filled;
 }
 
 // starting from a pixel at xy within a "component" aka a blob of same-colored pixels, increase x until it is next to a new color
@@ -327,16 +540,10 @@ void Surface::run_to_border(int& x, int& y)
 int offset8[8][2] = {{1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1}};
 int offset4[4][2] = {{1,0}, {0,1}, {-1,0}, {0,-1}};
 
-// true if free for growing components
+// true if free for growing components. x, y must not be on the sentinel
+// frame, which components can't grow next to.
 inline bool Surface::allow_grow(int x, int y, guint32 ownclr)
 {
-	if(x <= 0 || y <= 0)
-		return false;
-	if(x >= cairo_surface->get_width()-1)
-		return false;
-	if(y >= cairo_surface->get_height()-1)
-		return false;
-
 	guint8* pixels = cairo_surface->get_data();
 	int stride = cairo_surface->get_stride();
 
@@ -355,82 +562,128 @@ inline bool Surface::allow_grow(int x, int y, guint32 ownclr)
 	return true;
 }
 
-int growoff_o[3][3][2] =
-{
-	{{ 0,-1}, {-1,-1}, {-1,0}},
-	{{ 1,-1}, { 0, 0}, {-1,1}},
-	{{ 1, 0}, { 1, 1}, { 0,1}}
-};
+// iterations of calculate_outline between checkpoints
+static const int checkpoint_interval = 64;
 
-int growoff_i[3][3][2] =
+//! state of calculate_outline at the beginning of a segment of the trace
+struct trace_checkpoint
 {
-	{{-1, 0}, {-1, 1}, {0, 1}},
-	{{-1,-1}, { 0, 0}, {1, 1}},
-	{{ 0,-1}, { 1,-1}, {1, 0}}
+	trace_checkpoint( int xin, int yin, int xout, int yout, size_t outside_size, size_t inside_size )
+		: xin(xin), yin(yin), xout(xout), yout(yout),
+		  outside_size(outside_size), inside_size(inside_size),
+		  min_x( std::min(xin, xout) ), min_y( std::min(yin, yout) ),
+		  max_x( std::max(xin, xout) ), max_y( std::max(yin, yout) ) {}
+
+	void extend( int x, int y ) {
+		min_x = std::min(min_x, x);
+		min_y = std::min(min_y, y);
+		max_x = std::max(max_x, x);
+		max_y = std::max(max_y, y);
+	}
+
+	//! true if the segment came within margin of x, y
+	bool touches( int x, int y, int margin ) const {
+		return x >= min_x - margin && x <= max_x + margin &&
+		       y >= min_y - margin && y <= max_y + margin;
+	}
+
+	int xin, yin, xout, yout;
+	size_t outside_size, inside_size;
+	int min_x, min_y, max_x, max_y;	// area covered by the segment
 };
 
-void Surface::calculate_outline(const int x, const int y,
-				vector< pair<int,int> >& outside, vector< pair<int,int> >& inside)
+// the index in offset8 of the direction dx, dy, as direction8[dx + 1][dy + 1]
+static const int direction8[3][3] = {{5, 4, 3}, {6, 0, 2}, {7, 0, 1}};
+
+/* Two walkers trace the outline of the component: in runs along its border
+ * pixels, out along the pixels next to them. out turns around in (in the
+ * order of offset8) until it would enter the component, then in turns
+ * around out the other way until it would leave it. The pixels out passes
+ * make up the outside path.
+ *
+ * Directions are indices into offset8 and the probes are pointer offsets;
+ * thanks to the sentinel frame, none of them has to be bounds checked.
+ *
+ * Stray pixels can leave both walkers without a step. With repair, the
+ * pixels around in are then fixed (see below) and the trace goes on;
+ * without, the surface is only read, so several components can be traced at
+ * the same time, and false is returned to have the component traced again
+ * with repair.
+ */
+bool Surface::calculate_outline(const int x, const int y,
+				vector< pair<int,int> >& outside, vector< pair<int,int> >& inside,
+				bool repair)
 {
 	guint8* pixels = cairo_surface->get_data();
 	int stride = cairo_surface->get_stride();
-	int max_y = cairo_surface->get_height();
 
 	guint32 owncolor = PRC(pixels + x*4 + y*stride);
 
+	int neighbour[8];
+	for( int d = 0; d < 8; d++ )
+		neighbour[d] = offset8[d][0] * 4 + offset8[d][1] * stride;
+
 	int xstart = x;
 	int ystart = y;
 
 	run_to_border(xstart,ystart); //change xstart so that xstart++ would be outside of the component
+	guint8* start = pixels + xstart*4 + ystart*stride;
+
+	int xin = xstart-1;
+	int yin = ystart;
 	int xout = xstart;
 	int yout = ystart;
-	int xin = xout-1;
-	int yin = yout;
+	guint8* in = start - 4;
+	int out = 0;	// direction of out seen from in
 
 	outside.push_back( pair<int,int>(xout, yout) );
 
-	int blasts = 0;
+	/* the trace is divided into segments of checkpoint_interval iterations.
+	 * each segment remembers the tracer's state at its beginning and the
+	 * area it covered, so that a repair only needs to retrace from the
+	 * first segment that came near the repaired pixels.
+	 */
+	vector<trace_checkpoint> checkpoints;
+	trace_checkpoint current( xin, yin, xout, yout, outside.size(), inside.size() );
+	int iterations = 0;
 
 	while(true)
 	{
 		int i;
 		int steps = 0; // number of steps done in 1 iteration of the while loop
 
+		if( ++iterations == checkpoint_interval ) {
+			checkpoints.push_back(current);
+			current = trace_checkpoint( xin, yin, xout, yout, outside.size(), inside.size() );
+			iterations = 0;
+		}
+
 		// step outside
 		for(i = 0; i < 8; i++)
 		{
-			int xoff = xout - xin + 1;
-			int yoff = yout - yin + 1;
-			int xnext = xin + growoff_o[xoff][yoff][0];
-			int ynext = yin + growoff_o[xoff][yoff][1];
+			int next = (out + 1) % 8;
+			guint8* pixel = in + neighbour[next];
 
-			if(xnext == xstart && ynext == ystart)
+			if( pixel == start )
 			{
 				outside.push_back( pair<int,int>(xout, yout) );
 				outside.push_back( pair<int,int>(xstart, ystart) );
-				return;
-			}
-
-			if(xnext<0 || ynext<0 || xnext>stride || ynext>max_y)
-			{
-				save_debug_image("error_outerpath");
-				std::stringstream msg;
-				msg << "Outside path reaches image margins at " << xin << "," << yin << ")\n";
-				throw std::logic_error( msg.str() );
+				return true;
 			}
 
-			guint8* next = pixels + xnext*4 + ynext*stride;
-
-			if( PRC(next) != owncolor )
+			if( PRC(pixel) != owncolor )
 			{
 				outside.push_back( pair<int,int>(xout, yout) );
-				xout = xnext;
-				yout = ynext;
+				out = next;
+				xout = xin + offset8[out][0];
+				yout = yin + offset8[out][1];
 			}
 			else
 				break;
 		}
 		if( i == 8 ) {
+			if( !repair )
+				return false;
 			save_debug_image("error_outsideoverstepping");
 			std::stringstream msg;
 			msg << "Outside over-stepping at in(" << xin << "," << yin << ")\n";
@@ -438,35 +691,31 @@ void Surface::calculate_outline(const int x, const int y,
 		}
 
 		steps += i;
+		current.extend(xout, yout);
 
 
 		// step inside
+		guint8* outpixel = in + neighbour[out];
+		int back = (out + 4) % 8;	// direction of in seen from out
 		for(i = 0; i < 8; i++)
 		{
-			int xoff = xin - xout + 1;
-			int yoff = yin - yout + 1;
-			int xnext = xout + growoff_i[xoff][yoff][0];
-			int ynext = yout + growoff_i[xoff][yoff][1];
-			// next pixel  is checked clockwise
-			guint8* next = pixels + xnext*4 + ynext*stride;
-			if(xnext<0  || ynext<0 || xnext>stride || ynext>max_y)
-			{
-				save_debug_image("error_innerpath");
-				std::stringstream msg;
-				msg << "Inside path reaches image margins at " << xin << "," << yin << ")\n";
-				throw std::logic_error( msg.str() );
-			}
+			int next = (back + 7) % 8;
+			guint8* pixel = outpixel + neighbour[next];
 
-			if( PRC(next) == owncolor )
+			if( PRC(pixel) == owncolor )
 			{
 				inside.push_back( pair<int,int>(xin, yin) );
-				xin = xnext;
-				yin = ynext;
+				back = next;
+				xin = xout + offset8[back][0];
+				yin = yout + offset8[back][1];
+				in = pixel;
 			}
 			else
 				break;
 		}
 		if( i == 8 ) {
+			if( !repair )
+				return false;
 			save_debug_image("error_insideoverstepping");
 			std::stringstream msg;
 			msg << "Inside over-stepping at out(" << xout << "," << yout << ")\n";
@@ -474,12 +723,17 @@ void Surface::calculate_outline(const int x, const int y,
 		}
 
 		steps += i;
+		out = (back + 4) % 8;
+		current.extend(xin, yin);
 
 		// check whether we made any progress calculating the trace outline.
 		// if we haven't, our algorithm is deadlocked by stray pixels
 		// we try to resolve this by enforcing the algorithm's constraints
 		// for the components
 		if( steps == 0 ) {
+			if( !repair )
+				return false;
+
 			int changes = 0;
 			// test constraints for surrounding pixels, enforce if necessary
 			for(i = 0; i < 8; i++) {
@@ -505,7 +759,8 @@ void Surface::calculate_outline(const int x, const int y,
 					changes++;
 				}
 			}
-			if( allow_grow(xstart, ystart, owncolor) )
+			bool start_changed = allow_grow(xstart, ystart, owncolor);
+			if( start_changed )
 				PRC(pixels+xstart*4+ystart*stride) = owncolor;
 			
 			if( changes == 0 ) {
@@ -518,23 +773,140 @@ void Surface::calculate_outline(const int x, const int y,
 			} else
 				blasts++;
 
-			// start right at the beginning. still more efficient than keeping
-			// the history necessary to be able to continue next to the problem.
-			inside.clear();
-			outside.clear();
-			xstart = x;
-			ystart = y;
-			run_to_border(xstart,ystart);
-			xout = xstart;
-			yout = ystart;
-			xin = xout-1;
-			yin = yout;
-			outside.push_back( pair<int,int>(xout, yout) );
+			// the repair changed pixels next to xin, yin, and the tracer
+			// looks one pixel beyond its positions
+			checkpoints.push_back(current);
+			size_t resume = 0;
+			while( !start_changed && !checkpoints[resume].touches( xin, yin, 2 ) )
+				resume++;
+
+			if( resume == 0 ) {
+				// start right at the beginning
+				inside.clear();
+				outside.clear();
+				xstart = x;
+				ystart = y;
+				run_to_border(xstart,ystart);
+				start = pixels + xstart*4 + ystart*stride;
+				xout = xstart;
+				yout = ystart;
+				xin = xout-1;
+				yin = yout;
+				outside.push_back( pair<int,int>(xout, yout) );
+			} else {
+				// continue where the first affected segment began
+				xin = checkpoints[resume].xin;
+				yin = checkpoints[resume].yin;
+				xout = checkpoints[resume].xout;
+				yout = checkpoints[resume].yout;
+				outside.resize( checkpoints[resume].outside_size );
+				inside.resize( checkpoints[resume].inside_size );
+			}
+			in = pixels + xin*4 + yin*stride;
+			out = direction8[xout - xin + 1][yout - yin + 1];
+
+			checkpoints.erase( checkpoints.begin() + resume, checkpoints.end() );
+			current = trace_checkpoint( xin, yin, xout, yout, outside.size(), inside.size() );
+			iterations = 0;
 			continue;
 		}
 	}
+}
+
+/* Marching squares over the component containing x, y: the contour runs
+ * through the midpoints between the component's pixels and their outside
+ * neighbours, cutting the pixel corners. This is done by following the
+ * pixel edges ("cracks") along the border, keeping the component on the
+ * right and preferring left turns (so diagonal neighbours stay connected
+ * as in fill_a_component), and emitting the middle of every crack.
+ * Collinear midpoints are merged, so straight and 45 degree edges end up
+ * as single segments.
+ *
+ * The contour is in pixel coordinates and lies exactly on the border of the
+ * grown area, cutting up to 0.35 pixels into it at convex corners; the area
+ * is therefore grown by one more pixel for it (see get_toolpath), which keeps
+ * the contour at least a pixel away from the area grown for the tool, half a
+ * pixel more than the path of calculate_outline. The corners come from the pixels only, there is no
+ * interpolation between them.
+ */
+void Surface::calculate_contour(const int x, const int y, icoords& contour)
+{
+	guint8* pixels = cairo_surface->get_data();
+	int stride = cairo_surface->get_stride();
+	int width = cairo_surface->get_width();
+	int height = cairo_surface->get_height();
 
-	fprintf(stderr, "blasts: %d", blasts);
+	guint32 owncolor = PRC(pixels + x*4 + y*stride);
+
+	int xstart = x;
+	int ystart = y;
+	run_to_border(xstart, ystart);
+
+	// positions are pixel corners in doubled coordinates (corner cx, cy is
+	// the top left of pixel cx, cy), so that crack midpoints are integers.
+	// inside(x2, y2) tells whether the pixel around such a point belongs
+	// to the component.
+	#define CONTOUR_INSIDE(x2, y2) \
+		( PRC(pixels + ((x2) / 2) * 4 + ((y2) / 2) * stride) == owncolor )
+
+	// start on the crack right of the run, heading down
+	int cx = xstart, cy = ystart;
+	int dx = 0, dy = 1;
+	const int cx0 = cx, cy0 = cy, dx0 = dx, dy0 = dy;
+
+	vector< pair<int,int> > midpoints;
+	size_t max_steps = 4 * size_t(width) * size_t(height);
+
+	do {
+		midpoints.push_back( pair<int,int>( 2*cx + dx, 2*cy + dy ) );
+
+		// advance to the end of the crack, then decide where to turn
+		cx += dx;
+		cy += dy;
+
+		int lx = dy, ly = -dx;		// left of the direction (y points down)
+		int rx = -dy, ry = dx;		// right of the direction
+
+		if( CONTOUR_INSIDE( 2*cx + dx + lx, 2*cy + dy + ly ) ) {
+			dx = lx;
+			dy = ly;
+		} else if( !CONTOUR_INSIDE( 2*cx + dx + rx, 2*cy + dy + ry ) ) {
+			dx = rx;
+			dy = ry;
+		}
+
+		if( midpoints.size() > max_steps ) {
+			save_debug_image("error_contour");
+			std::stringstream msg;
+			msg << "calculate_contour(): contour doesn't close, starting at (" << xstart << "," << ystart << ")\n";
+			throw std::logic_error( msg.str() );
+		}
+	} while( cx != cx0 || cy != cy0 || dx != dx0 || dy != dy0 );
+
+	#undef CONTOUR_INSIDE
+
+	// merge collinear midpoints; the contour is closed, so the first point
+	// is checked against the last one as well
+	vector< pair<int,int> > corners;
+	size_t n = midpoints.size();
+	for( size_t i = 0; i < n; i++ ) {
+		const pair<int,int>& prev = midpoints[ (i + n - 1) % n ];
+		const pair<int,int>& here = midpoints[i];
+		const pair<int,int>& next = midpoints[ (i + 1) % n ];
+
+		long cross = long( here.first - prev.first ) * ( next.second - here.second )
+			   - long( here.second - prev.second ) * ( next.first - here.first );
+		if( cross != 0 )
+			corners.push_back(here);
+	}
+	if( corners.empty() )
+		corners = midpoints;
+
+	// back from doubled corner coordinates to pixel centers
+	BOOST_FOREACH( const coordpair& corner, corners ) {
+		contour.push_back( icoordpair( ( corner.first - 1 ) / 2.0, ( corner.second - 1 ) / 2.0 ) );
+	}
+	contour.push_back( contour.front() );
 }
 
 guint Surface::grow_a_component(int x, int y, int& contentions)
@@ -593,22 +965,23 @@ void Surface::add_mask( shared_ptr<Surface> mask_surface) {
 	guint8* pixels = cairo_surface->get_data();
 	guint8* mask_pixels = mask_cairo_surface->get_data();
 
+	/* engrave only on the surface area, and tint the outside in an own
+	 * color to block extension */
 	for(int y = 0; y < max_y; y ++)
-	{
-		for(int x = 0; x < max_x; x ++)
-		{
-			PRC(pixels + x*4 + y*stride) &= PRC(mask_pixels + x*4 + y*stride); /* engrave only on the surface area */
-			PRC(pixels + x*4 + y*stride) |= (~PRC(mask_pixels + x*4 + y*stride) & (RED | BLUE)); /* tint the outiside in an own color to block extension */
-		}
-	}
+		rasterops::mask( row(pixels, stride, y), row(mask_pixels, stride, y), max_x, RED | BLUE );
 }
 
 #include <boost/format.hpp>
 
+bool Surface::debug_images = true;
+
 void Surface::save_debug_image(string message)
 {
 	static uint debug_image_index = 0;
 
+	if( !debug_images )
+		return;
+
 	opacify(pixbuf);
 	pixbuf->save( (boost::format("outp%1%_%2%.png") % debug_image_index % message).str() , "png");
 	debug_image_index++;
@@ -619,34 +992,36 @@ void Surface::opacify( Glib::RefPtr<Gdk::Pixbuf> pixbuf )
 	int stride = pixbuf->get_rowstride();
 	guint8* pixels = pixbuf->get_pixels();
 	for(int y = 0; y < pixbuf->get_height(); y++ )
-	{
-		for(int x = 0; x < pixbuf->get_width(); x++ )
-		{
-			PRC(pixels + x*4 + y*stride) |= OPAQUE;
-		}
-	}
+		rasterops::set_bits( row(pixels, stride, y), pixbuf->get_width(), OPAQUE );
 }
 
 void Surface::fill_outline ( double linewidth )
 {
 	/* paint everything white that can not be reached from outside the image */
 
+	// that makes white pixels the bitmap doesn't have
+	bitmap.clear();
+
 	int stride = pixbuf->get_rowstride();
 	guint8* pixels = pixbuf->get_pixels();
 
+	// the area inside the sentinel frame
+	int max_x = pixbuf->get_width() - 2;
+	int max_y = pixbuf->get_height() - 2;
+
 	/* in order to find out what is "outside", we need to walk "around' the image */
-	for(int x = 0; x < pixbuf->get_width(); x++ )
+	for(int x = 1; x <= max_x; x++ )
 	{
-		if(PRC(pixels + x*4 + 0*stride) != BLACK) throw std::logic_error( "Non-black pixel at top border" );
-		if(PRC(pixels + x*4 + (pixbuf->get_height() - 1)*stride) != BLACK) throw std::logic_error( "Non-black pixel at bottom border" );
+		if(PRC(pixels + x*4 + 1*stride) != BLACK) throw std::logic_error( "Non-black pixel at top border" );
+		if(PRC(pixels + x*4 + max_y*stride) != BLACK) throw std::logic_error( "Non-black pixel at bottom border" );
 	}
-	for(int y = 0; y < pixbuf->get_height(); y++ )
+	for(int y = 1; y <= max_y; y++ )
 	{
-		if(PRC(pixels + 0*4 + y*stride) != BLACK) throw std::logic_error( "Non-black pixel at left border" );
-		if(PRC(pixels + (pixbuf->get_width() - 1)*4 + y*stride) != BLACK) throw std::logic_error( "Non-black pixel at right border" );
+		if(PRC(pixels + 1*4 + y*stride) != BLACK) throw std::logic_error( "Non-black pixel at left border" );
+		if(PRC(pixels + max_x*4 + y*stride) != BLACK) throw std::logic_error( "Non-black pixel at right border" );
 	}
 
-	fill_a_component(0, 0, BLUE);
+	fill_a_component(1, 1, BLUE);
 
 	/* everything else (that is, the area of the board) will be black
 	 *
@@ -654,17 +1029,11 @@ void Surface::fill_outline ( double linewidth )
 	 * black so grow's run_to_border can work.
 	 */
 	int first_line_with_black = 0;
-	for(int y = 0; y < pixbuf->get_height(); y++ )
+	for(int y = 1; y <= max_y; y++ )
 	{
-		for(int x = 0; x < pixbuf->get_width(); x++ )
-		{
-			if(PRC(pixels + x*4 + y*stride) != BLUE) {
-				PRC(pixels + x*4 + y*stride) = BLACK;
-				if(first_line_with_black == 0) {
-					first_line_with_black = y;
-				}
-			} 
-		}
+		if( rasterops::remap( row(pixels, stride, y) + 1, max_x, BLUE, BLUE, BLACK ) &&
+		    first_line_with_black == 0 )
+			first_line_with_black = y;
 	}
 
 	/* compensate for growth induced by line thicknesses.
@@ -683,7 +1052,7 @@ void Surface::fill_outline ( double linewidth )
 	for(int i = 0; i < grow; ++i)
 	{
 		// starting at the very left 
-		added = grow_a_component(0, first_line_with_black + grow, contentions);
+		added = grow_a_component(1, first_line_with_black + grow, contentions);
 	}
 	// if you can think of a sane situation in which either of this could
 	// occur and nevertheless give a meaningful result, change it to a
@@ -691,16 +1060,8 @@ void Surface::fill_outline ( double linewidth )
 	if(!added) throw std::logic_error( "Shrinking the outline by half the line width came to a halt." );
 	if(contentions) throw std::logic_error( "Shrinking the outline collided with something while there should not be anything." );
 
-	for(int y = 0; y < pixbuf->get_height(); y++ )
-	{
-		for(int x = 0; x < pixbuf->get_width(); x++ )
-		{
-			if(PRC(pixels + x*4 + y*stride) == BLUE)
-				PRC(pixels + x*4 + y*stride) = BLACK;
-			else
-				PRC(pixels + x*4 + y*stride) = WHITE;
-		}
-	}
+	for(int y = 1; y <= max_y; y++ )
+		rasterops::remap( row(pixels, stride, y) + 1, max_x, BLUE, BLACK, WHITE );
 
 	save_debug_image("outline_filled");
 }
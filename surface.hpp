@@ -35,6 +35,7 @@ using std::vector;
 using Glib::ustring;
 
 #include "coord.hpp"
+#include "toolpath.hpp"
 #include "mill.hpp"
 #include "gerberimporter.hpp"
 
@@ -50,41 +51,66 @@ public:
 
 	void save_debug_image(string);
 
-	vector< shared_ptr<icoords> > get_toolpath( shared_ptr<RoutingMill> mill, bool mirror, bool mirror_absolute );
+	void get_toolpath( shared_ptr<RoutingMill> mill, bool mirror, bool mirror_absolute, ToolpathSet& toolpath );
 	ivalue_t get_width_in() { return max_x - min_x; };
 	ivalue_t get_height_in() { return max_y - min_y; };
 
 	void add_mask( shared_ptr<Surface>);
 	void fill_outline(double linewidth);
 
+	//! bytes a surface of the given dimensions (in inches) will allocate
+	static size_t get_memory_footprint( guint dpi, ivalue_t width, ivalue_t height );
+
+	//! enables or disables save_debug_image for all surfaces
+	static void set_debug_images( bool enabled ) { debug_images = enabled; };
+
+	//! number of stray pixel repairs calculate_outline had to do so far
+	uint get_blasts() { return blasts; };
+
+	//! number of threads tracing the outlines of the components
+	static void set_tracing_threads( uint threads ) { tracing_threads = threads; };
+
+	//! trace the toolpaths with calculate_contour instead of calculate_outline
+	void set_marching_squares( bool enabled ) { marching_squares = enabled; };
+
 protected:
 	Glib::RefPtr<Gdk::Pixbuf> pixbuf;
 	Cairo::RefPtr<Cairo::ImageSurface> cairo_surface;
+	//! the rendered layer, one bit per pixel, until the components are filled
+	Cairo::RefPtr<Cairo::ImageSurface> bitmap;
 
 	static const int procmargin = 10;
+	static bool debug_images;
+	static uint tracing_threads;
 
 	const ivalue_t dpi;
 	const ivalue_t min_x, max_x, min_y, max_y;
 	const int zero_x, zero_y;
 
 	void make_the_surface(uint width, uint height);
+	void draw_sentinel();
 
 	// Image Processing Methods
 
-	inline ivalue_t xpt2i( int xpt ) { return ivalue_t(xpt - zero_x) / ivalue_t(dpi); }
-	inline ivalue_t ypt2i( int ypt ) { return ivalue_t(ypt - zero_y) / ivalue_t(dpi); }
+	inline ivalue_t xpt2i( ivalue_t xpt ) { return (xpt - zero_x) / ivalue_t(dpi); }
+	inline ivalue_t ypt2i( ivalue_t ypt ) { return (ypt - zero_y) / ivalue_t(dpi); }
 
 	inline int xi2pt( ivalue_t xi ) { return int(xi * ivalue_t(dpi)) + zero_x; }
 	inline int yi2pt( ivalue_t yi ) { return int(yi * ivalue_t(dpi)) + zero_y; }
 
 	std::vector< std::pair<int,int> > fill_all_components();
-	void fill_a_component(int x, int y, guint32 argb);
+	uint fill_a_component(int x, int y, guint32 argb);
 	uint grow_a_component(int x, int y, int& contentions);
 	inline bool allow_grow(int x, int y, guint32 ownclr);
 
 	void run_to_border(int& x, int& y);
-	void calculate_outline(int x, int y, vector< std::pair<int,int> >& outside,
-			       vector< std::pair<int,int> >& inside);
+	bool calculate_outline(int x, int y, vector< std::pair<int,int> >& outside,
+			       vector< std::pair<int,int> >& inside, bool repair = true);
+	void calculate_contour(int x, int y, icoords& contour);
+
+	struct trace_pass;
+	void trace_components( trace_pass& pass );
+	void trace_worker( trace_pass* pass );
 
 	// Misc. Functions
 	static void opacify( Glib::RefPtr<Gdk::Pixbuf> pixbuf );
@@ -92,6 +118,10 @@ protected:
 	guint32 clr;
 	guint32 get_an_unused_color();
 	std::vector<guint32> usedcolors;
+	std::vector<uint> component_sizes;	// pixels of each component when filled
+
+	bool marching_squares;
+	uint blasts;
 };
 
 
@@ -26,12 +26,16 @@ using namespace std;
 #include "svg_exporter.hpp"
 
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
 
 using std::pair;
 
 
 
 SVG_Exporter::SVG_Exporter( shared_ptr<Board> board )
+	: buffer( 1 << 20 ), in_group(false), in_path(false), need_command(false),
+	  pen_x(0), pen_y(0), start_x(0), start_y(0)
 {
 	this->dpi = 72;
 	this->board = board;
@@ -40,76 +44,156 @@ SVG_Exporter::SVG_Exporter( shared_ptr<Board> board )
 
 SVG_Exporter::~SVG_Exporter()
 {
-	// something to do here?
-	// closing svg??
+	if( svg.is_open() ) {
+		end_group();
+		svg << "</svg>\n";
+		svg.close();
+	}
 }
 
 
 void
 SVG_Exporter::create_svg( string filename )
 {
-	
-	//create the svg
-	cairo_svgsurface = Cairo::SvgSurface::create(filename, board->get_width() * dpi, board->get_height() * dpi);
-	//get the cairo drawing area
-	cr = Cairo::Context::create(cairo_svgsurface);
-
-	//setup
-	cr->set_line_width(0.1);    // set line width
-	cr->set_source_rgba(1.0, 0.0, 0.0, 1.0); // set initial color...
+	// a large buffer, the paths are written a few bytes at a time
+	svg.rdbuf()->pubsetbuf( &buffer[0], buffer.size() );
+	svg.open( filename.c_str() );
+
+	svg << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	    << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\""
+	    << board->get_width() * dpi << "pt\" height=\"" << board->get_height() * dpi
+	    << "pt\" viewBox=\"0 0 " << board->get_width() * dpi << " " << board->get_height() * dpi << "\">\n";
+
+	// the initial color
+	svg << "<g fill=\"none\" stroke=\"#ff0000\" stroke-width=\"0.1\">\n";
+	in_group = true;
 }
 
 
 void
 SVG_Exporter::set_rand_color()
 {
-	cr->set_source_rgb( (rand()%256)/256., (rand()%256)/256., (rand()%256)/256.);
+	end_group();
+
+	char color[8];
+	snprintf( color, sizeof(color), "#%02x%02x%02x", rand() % 256, rand() % 256, rand() % 256 );
+	svg << "<g fill=\"none\" stroke=\"" << color << "\" stroke-width=\"0.1\">\n";
+	in_group = true;
+}
+
+
+//! writes a coordinate in 1/1000 points as a decimal number, in path data
+//! after a space unless the minus sign separates it from the previous one
+void
+SVG_Exporter::put( long units, bool separate )
+{
+	char text[32];
+	char* p = text;
+
+	if( units < 0 )
+		*p++ = '-';
+	else if( separate )
+		*p++ = ' ';
+
+	unsigned long magnitude = units < 0 ? -units : units;
+	p += snprintf( p, sizeof(text) - 1, "%lu", magnitude / 1000 );
+
+	unsigned long fraction = magnitude % 1000;
+	if( fraction ) {
+		*p++ = '.';
+		for( unsigned long digit = 100; fraction; digit /= 10 ) {
+			*p++ = '0' + fraction / digit;
+			fraction %= digit;
+		}
+	}
+
+	svg.write( text, p - text );
 }
 
 
 void 
 SVG_Exporter::move_to(ivalue_t x, ivalue_t y)
 {
-	cr->move_to(x * dpi, y * dpi);
+	end_path();
+
+	pen_x = start_x = to_units(x);
+	pen_y = start_y = to_units(y);
+	svg << "<path d=\"M";
+	put( pen_x );
+	put( pen_y );
+	in_path = true;
+	need_command = true;
 }
 
 
 void
 SVG_Exporter::line_to(ivalue_t x, ivalue_t y)
 {
-	cr->line_to(x * dpi, y * dpi);
+	if( !in_path ) {
+		move_to( x, y );
+		return;
+	}
+
+	if( need_command ) {
+		svg << "l";
+		need_command = false;
+	}
+
+	long ux = to_units(x), uy = to_units(y);
+	put( ux - pen_x );
+	put( uy - pen_y );
+	pen_x = ux;
+	pen_y = uy;
 }
 
 
 void
 SVG_Exporter::circle(ivalue_t x, ivalue_t y, ivalue_t rad)
 {
-	cr->arc( x * dpi, y * dpi, rad, 0.0, 2.0 * M_PI);
+	end_path();
+
+	svg << "<circle cx=\"";
+	put( to_units(x), false );
+	svg << "\" cy=\"";
+	put( to_units(y), false );
+	svg << "\" r=\"" << rad << "\"/>\n";
 }
 
 
 void
 SVG_Exporter::close_path()
 {
-	cr->close_path();
+	if( in_path ) {
+		svg << "z";
+		pen_x = start_x;
+		pen_y = start_y;
+		need_command = true;
+	}
 }
 
 void
 SVG_Exporter::stroke()
 {
-	cr->stroke();
+	end_path();
 }
 
 
 void
-SVG_Exporter::show_page()
+SVG_Exporter::end_path()
 {
-	cr->show_page();
+	if( in_path ) {
+		svg << "\"/>\n";
+		in_path = false;
+	}
 }
 
 
 void
-SVG_Exporter::copy_page()
+SVG_Exporter::end_group()
 {
-	cr->copy_page();
-}
\ No newline at end of file
+	end_path();
+	if( in_group ) {
+		svg << "</g>\n";
+		in_group = false;
+	}
+}
@@ -26,6 +26,8 @@ using std::string;
 
 #include <vector>
 using std::vector;
+#include <fstream>
+#include <cmath>
 #include <map>
 using std::map;
 
@@ -46,10 +48,15 @@ using Glib::ustring;
 #include "exporter.hpp"
 
 
+//! writes the preview of the toolpaths and drill holes as SVG
+/*! The elements go straight into the file as they are drawn: a <path> per
+ *  contour, with coordinates relative to the previous point, and a
+ *  <circle> per hole, in groups of one colour. Coordinates are in points
+ *  (1/72 inch), rounded to 1/1000 point.
+ */
 class SVG_Exporter
 {
 public:
-	//SVG_Exporter(string filename, const ivalue_t board_width, const ivalue_t board_height);
 	SVG_Exporter( shared_ptr<Board> board );
 	~SVG_Exporter();
 	
@@ -60,19 +67,25 @@ public:
 	void circle(ivalue_t x, ivalue_t y, ivalue_t rad);
 	void close_path();
 	void stroke();
-	void show_page();
-	void copy_page();
-	
 
 protected:
 	
 	int dpi;
 	
 	shared_ptr<Board> board;
-	
-	Cairo::RefPtr<Cairo::SvgSurface> cairo_svgsurface;
-	Cairo::RefPtr<Cairo::Context> cr;
 
+	vector<char> buffer;		// before svg, which writes from it until it is closed
+	std::ofstream svg;
+
+	bool in_group, in_path;
+	bool need_command;		// the next numbers need an "l" before them
+	long pen_x, pen_y;		// last point written, in 1/1000 points
+	long start_x, start_y;		// start of the subpath, where "z" returns to
+
+	long to_units( ivalue_t v ) { return lround( v * dpi * 1000 ); }
+	void put( long units, bool separate = true );
+	void end_path();
+	void end_group();
 };
 
 #endif // SVGEXPORTER_H
@@ -0,0 +1,80 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "toolpath.hpp"
+
+#include <boost/foreach.hpp>
+
+void ToolpathSet::begin_contour( bool closed, int pass, ivalue_t depth )
+{
+	contour_info contour;
+	contour.begin = xs.size();
+	contour.closed = closed;
+	contour.pass = pass;
+	contour.depth = depth;
+	contours.push_back(contour);
+}
+
+void ToolpathSet::add_point( ivalue_t x, ivalue_t y, ivalue_t z )
+{
+	// the points so far are at the working depth
+	if( zs.empty() )
+		zs.resize( xs.size(), 0 );
+
+	xs.push_back( to_tvalue(x) );
+	ys.push_back( to_tvalue(y) );
+	zs.push_back( to_tvalue(z) );
+}
+
+void ToolpathSet::add_contour( const icoords& points, bool closed, int pass )
+{
+	begin_contour( closed, pass );
+	BOOST_FOREACH( const icoordpair& point, points ) {
+		add_point( point.first, point.second );
+	}
+}
+
+size_t ToolpathSet::get_memory_footprint() const
+{
+	return contours.capacity() * sizeof(contour_info) +
+		( xs.capacity() + ys.capacity() + zs.capacity() ) * sizeof(tvalue_t);
+}
+
+void ToolpathSet::reserve( size_t contour_count, size_t point_count )
+{
+	contours.reserve(contour_count);
+	xs.reserve(point_count);
+	ys.reserve(point_count);
+}
+
+void ToolpathSet::swap( ToolpathSet& other )
+{
+	contours.swap( other.contours );
+	xs.swap( other.xs );
+	ys.swap( other.ys );
+	zs.swap( other.zs );
+}
+
+void ToolpathSet::clear()
+{
+	contours.clear();
+	xs.clear();
+	ys.clear();
+	zs.clear();
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOOLPATH_H
+#define TOOLPATH_H
+
+#include <cstddef>
+#include <vector>
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+
+#include "coord.hpp"
+
+//! The toolpaths of a layer: all contours in flat coordinate arrays.
+/*! The points of contour i are at positions contour_begin(i) to
+ *  contour_end(i) - 1 of the x, y (and, once any point got one, z)
+ *  arrays, in the tvalue_t representation chosen at compile time (see
+ *  coord.hpp). Every contour carries whether it is closed, the isolation pass
+ *  it belongs to and its depth relative to the mill's working depth.
+ *
+ *  Sets are not copyable; they are handed on between the stages with
+ *  swap, which doesn't touch the points.
+ */
+class ToolpathSet : boost::noncopyable
+{
+public:
+	ToolpathSet() {};
+
+	//! starts a new contour; the following points are added to it
+	void begin_contour( bool closed = true, int pass = 0, ivalue_t depth = 0 );
+
+	void add_point( ivalue_t x, ivalue_t y ) {
+		xs.push_back( to_tvalue(x) );
+		ys.push_back( to_tvalue(y) );
+		if( !zs.empty() )
+			zs.push_back(0);
+	};
+	void add_point( ivalue_t x, ivalue_t y, ivalue_t z );
+
+	//! adds points as a new contour
+	void add_contour( const icoords& points, bool closed = true, int pass = 0 );
+
+	//! number of contours
+	size_t size() const { return contours.size(); };
+	bool empty() const { return contours.empty(); };
+	size_t point_count() const { return xs.size(); };
+	bool has_z() const { return !zs.empty(); };
+
+	size_t contour_begin( size_t i ) const { return contours[i].begin; };
+	size_t contour_end( size_t i ) const {
+		return i + 1 < contours.size() ? contours[i + 1].begin : xs.size();
+	};
+	size_t contour_size( size_t i ) const { return contour_end(i) - contour_begin(i); };
+	bool is_closed( size_t i ) const { return contours[i].closed; };
+	int get_pass( size_t i ) const { return contours[i].pass; };
+	ivalue_t get_depth( size_t i ) const { return contours[i].depth; };
+
+	ivalue_t x( size_t point ) const { return from_tvalue( xs[point] ); };
+	ivalue_t y( size_t point ) const { return from_tvalue( ys[point] ); };
+	ivalue_t z( size_t point ) const { return zs.empty() ? 0 : from_tvalue( zs[point] ); };
+
+	//! true if two points are at the same x (or y) position, compared
+	//! without conversion
+	bool same_x( size_t a, size_t b ) const { return xs[a] == xs[b]; };
+	bool same_y( size_t a, size_t b ) const { return ys[a] == ys[b]; };
+
+	//! bytes used by the points and the contour table
+	size_t get_memory_footprint() const;
+
+	void reserve( size_t contour_count, size_t point_count );
+	void swap( ToolpathSet& other );
+	void clear();
+
+private:
+	struct contour_info {
+		size_t begin;
+		bool closed;
+		int pass;
+		ivalue_t depth;
+	};
+
+	vector<contour_info> contours;
+	vector<tvalue_t> xs;
+	vector<tvalue_t> ys;
+	vector<tvalue_t> zs;
+};
+
+#endif // TOOLPATH_H
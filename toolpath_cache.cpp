@@ -0,0 +1,210 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "toolpath_cache.hpp"
+#include "hash.hpp"
+
+#include <unistd.h>
+#include <ctime>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+namespace fs = boost::filesystem;
+
+static const char magic[8] = { 'p', 'c', 'b', '2', 'g', 'c', 'o', 'd' };
+static const uint32_t format_version = 3;
+// detects entries written on a machine of different endianness
+static const uint32_t byte_order = 0x01020304;
+
+static const char* entry_extension = ".toolpaths";
+
+template <typename T>
+static void write_value( std::ostream& out, T value )
+{
+	out.write( reinterpret_cast<const char*>( &value ), sizeof(T) );
+}
+
+template <typename T>
+static bool read_value( std::istream& in, T& value )
+{
+	return in.read( reinterpret_cast<char*>( &value ), sizeof(T) ).good();
+}
+
+ToolpathCache::ToolpathCache( const string& directory, uintmax_t max_size )
+	: directory(directory), max_size(max_size)
+{
+}
+
+string
+ToolpathCache::entry_path( const string& key )
+{
+	return ( fs::path(directory) / ( Hash().add(key).hex() + entry_extension ) ).string();
+}
+
+bool
+ToolpathCache::load( const string& key, ToolpathSet& toolpath )
+{
+	string path = entry_path(key);
+	std::ifstream in( path.c_str(), std::ios::binary );
+	if( !in.good() )
+		return false;
+
+	char file_magic[sizeof(magic)];
+	uint32_t version, order, key_length, path_count;
+	if( !in.read( file_magic, sizeof(magic) ) || !std::equal( magic, magic + sizeof(magic), file_magic ) ||
+	    !read_value( in, version ) || version != format_version ||
+	    !read_value( in, order ) || order != byte_order ||
+	    !read_value( in, key_length ) || key_length != key.size() )
+		return false;
+
+	string file_key( key_length, '\0' );
+	if( !in.read( &file_key[0], key_length ) || file_key != key )
+		return false;
+
+	uint32_t has_z;
+	if( !read_value( in, path_count ) || !read_value( in, has_z ) )
+		return false;
+
+	ToolpathSet paths;
+	for( uint32_t i = 0; i < path_count; i++ ) {
+		uint32_t point_count, closed;
+		int32_t pass;
+		double depth;
+		if( !read_value( in, point_count ) || !read_value( in, closed ) ||
+		    !read_value( in, pass ) || !read_value( in, depth ) )
+			return false;
+
+		paths.begin_contour( closed, pass, depth );
+		for( uint32_t j = 0; j < point_count; j++ ) {
+			double x, y, z;
+			if( !read_value( in, x ) || !read_value( in, y ) )
+				return false;
+			if( !has_z ) {
+				paths.add_point( x, y );
+			} else {
+				if( !read_value( in, z ) )
+					return false;
+				paths.add_point( x, y, z );
+			}
+		}
+	}
+
+	toolpath.swap( paths );
+
+	// the modification time tracks the last use for eviction
+	try {
+		fs::last_write_time( path, std::time(NULL) );
+	} catch( fs::filesystem_error& e ) {
+	}
+
+	return true;
+}
+
+void
+ToolpathCache::store( const string& key, const ToolpathSet& toolpath )
+{
+	string path = entry_path(key);
+
+	// write to a temporary file first so that concurrent runs never see
+	// half-written entries
+	char suffix[64];
+	snprintf( suffix, sizeof(suffix), ".%ld-%p", static_cast<long>( getpid() ), static_cast<void*>( this ) );
+	string temp_path = path + suffix;
+
+	try {
+		fs::create_directories( directory );
+
+		{
+			std::ofstream out( temp_path.c_str(), std::ios::binary | std::ios::trunc );
+
+			out.write( magic, sizeof(magic) );
+			write_value<uint32_t>( out, format_version );
+			write_value<uint32_t>( out, byte_order );
+			write_value<uint32_t>( out, key.size() );
+			out.write( key.data(), key.size() );
+
+			write_value<uint32_t>( out, toolpath.size() );
+			write_value<uint32_t>( out, toolpath.has_z() );
+			for( size_t i = 0; i < toolpath.size(); i++ ) {
+				write_value<uint32_t>( out, toolpath.contour_size(i) );
+				write_value<uint32_t>( out, toolpath.is_closed(i) );
+				write_value<int32_t>( out, toolpath.get_pass(i) );
+				write_value<double>( out, toolpath.get_depth(i) );
+				for( size_t j = toolpath.contour_begin(i); j < toolpath.contour_end(i); j++ ) {
+					write_value<double>( out, toolpath.x(j) );
+					write_value<double>( out, toolpath.y(j) );
+					if( toolpath.has_z() )
+						write_value<double>( out, toolpath.z(j) );
+				}
+			}
+
+			if( !out.good() ) {
+				out.close();
+				fs::remove( temp_path );
+				return;
+			}
+		}
+
+		fs::rename( temp_path, path );
+		evict();
+	} catch( fs::filesystem_error& e ) {
+		std::remove( temp_path.c_str() );
+	}
+}
+
+/* Removes the least recently used entries until the cache fits into
+ * max_size again.
+ */
+void
+ToolpathCache::evict()
+{
+	typedef std::pair< std::time_t, fs::path > entry_t;
+	vector<entry_t> entries;
+	uintmax_t size = 0;
+
+	for( fs::directory_iterator it( directory ), end; it != end; ++it ) {
+		if( !fs::is_regular_file( it->status() ) || it->path().extension() != entry_extension )
+			continue;
+
+		try {
+			size += fs::file_size( it->path() );
+			entries.push_back( entry_t( fs::last_write_time( it->path() ), it->path() ) );
+		} catch( fs::filesystem_error& e ) {
+			// removed by a concurrent run
+		}
+	}
+
+	std::sort( entries.begin(), entries.end() );
+
+	BOOST_FOREACH( entry_t& entry, entries ) {
+		if( size <= max_size )
+			break;
+
+		try {
+			uintmax_t entry_size = fs::file_size( entry.second );
+			fs::remove( entry.second );
+			size -= entry_size;
+		} catch( fs::filesystem_error& e ) {
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOOLPATH_CACHE_H
+#define TOOLPATH_CACHE_H
+
+#include <stdint.h>
+
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+
+#include "toolpath.hpp"
+
+//! Persistent store for the toolpaths of layers, shared between runs.
+/*! Entries are addressed by a key that describes everything the toolpaths
+ *  of a layer depend on (see Board::get_layer_key). The file name is
+ *  derived from a hash of the key, and the full key is stored in the entry
+ *  and compared on lookup, so hash collisions can't return foreign paths.
+ *
+ *  The cache never makes a run fail: unreadable, damaged or foreign
+ *  entries are misses, and errors while storing are ignored. The least
+ *  recently used entries are removed when the cache outgrows its size limit.
+ */
+class ToolpathCache : boost::noncopyable
+{
+public:
+	ToolpathCache( const string& directory, uintmax_t max_size );
+
+	//! returns true and fills toolpath if an entry for key exists
+	bool load( const string& key, ToolpathSet& toolpath );
+	void store( const string& key, const ToolpathSet& toolpath );
+
+private:
+	string entry_path( const string& key );
+	void evict();
+
+	string directory;
+	uintmax_t max_size;
+};
+
+#endif // TOOLPATH_CACHE_H
@@ -0,0 +1,301 @@
+/*
+ * This file is part of pcb2gcode.
+ * 
+ * Copyright (C) 2014 The pcb2gcode authors (see AUTHORS)
+ * 
+ * pcb2gcode is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * pcb2gcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with pcb2gcode.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOOLPATH_FILE_H
+#define TOOLPATH_FILE_H
+
+/*! The binary toolpath format written by BinaryExporter (--binary), and a
+ *  reader for it that depends on nothing but the C++ library and POSIX, so
+ *  that other programs can copy this header to read the files.
+ *
+ *  All numbers are little-endian; lengths are in inches. The file starts
+ *  with a file_header, and everything else is found through the offsets
+ *  (from the start of the file) in there:
+ *
+ *    layer_record[layer_count]		at layers_offset
+ *    drill_record[drill_count]		at drills_offset
+ *
+ *  Each layer points to its contour_record[contour_count] and to the x, y
+ *  and (if LAYER_HAS_Z is set) z coordinates of all its points as separate
+ *  double[point_count] arrays; contour i consists of the points from its
+ *  begin to begin + size. Each drill record points to the x and y arrays
+ *  of its holes, at the positions the drill G-code goes to. All records and
+ *  arrays are 8 byte aligned, so the reader hands out pointers into the
+ *  mapped file instead of copying.
+ */
+
+#include <stdint.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace toolpath_file
+{
+	static const char magic[8] = { 'p', 'c', 'b', '2', 'g', 't', 'p', 'f' };
+	static const uint32_t version = 1;
+
+	enum { LAYER_HAS_Z = 1 };
+
+	struct file_header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t layer_count;
+		uint32_t drill_count;
+		uint32_t reserved;
+		double min_x, min_y, max_x, max_y;	// the board
+		uint64_t layers_offset;
+		uint64_t drills_offset;
+	};
+
+	struct layer_record
+	{
+		char name[16];				// zero padded
+		double tool_diameter;
+		double feed;				// ipm
+		double zsafe, zwork, zchange;
+		double stepsize;			// 0 if cut in one pass
+		int32_t speed;				// rpm
+		uint32_t flags;
+		uint64_t contour_count, point_count;
+		uint64_t contours_offset;
+		uint64_t x_offset, y_offset, z_offset;	// z_offset is 0 without LAYER_HAS_Z
+	};
+
+	struct contour_record
+	{
+		uint64_t begin, size;
+		int32_t pass;				// 0 for the first isolation pass
+		uint32_t closed;
+		double depth;
+	};
+
+	struct drill_record
+	{
+		int32_t tool;				// number in the drill file
+		uint32_t reserved;
+		double diameter;
+		uint64_t hole_count;
+		uint64_t x_offset, y_offset;
+	};
+
+	// the records have the same layout on every common ABI
+	typedef char check_file_header[ sizeof(file_header) == 72 ? 1 : -1 ];
+	typedef char check_layer_record[ sizeof(layer_record) == 120 ? 1 : -1 ];
+	typedef char check_contour_record[ sizeof(contour_record) == 32 ? 1 : -1 ];
+	typedef char check_drill_record[ sizeof(drill_record) == 40 ? 1 : -1 ];
+
+	inline bool little_endian()
+	{
+		const uint32_t one = 1;
+		return *reinterpret_cast<const char*>( &one ) == 1;
+	}
+
+	//! a contour as pointers into the file
+	class Contour
+	{
+	public:
+		Contour( const contour_record& record, const double* xs, const double* ys, const double* zs )
+			: record(record), xs( xs + record.begin ), ys( ys + record.begin ),
+			  zs( zs ? zs + record.begin : 0 ) {}
+
+		size_t size() const { return record.size; }
+		bool closed() const { return record.closed; }
+		int pass() const { return record.pass; }
+		double depth() const { return record.depth; }
+
+		const double* x() const { return xs; }
+		const double* y() const { return ys; }
+		//! NULL if the layer has no z coordinates
+		const double* z() const { return zs; }
+
+	private:
+		const contour_record& record;
+		const double* xs;
+		const double* ys;
+		const double* zs;
+	};
+
+	class Layer
+	{
+	public:
+		Layer( const layer_record& record, const contour_record* contours,
+		       const double* xs, const double* ys, const double* zs )
+			: record(record), contours(contours), xs(xs), ys(ys), zs(zs) {}
+
+		std::string name() const { return std::string( record.name, strnlen( record.name, sizeof(record.name) ) ); }
+		const layer_record& tool() const { return record; }
+
+		size_t contour_count() const { return record.contour_count; }
+		Contour contour( size_t i ) const { return Contour( contours[i], xs, ys, zs ); }
+
+	private:
+		const layer_record& record;
+		const contour_record* contours;
+		const double* xs;
+		const double* ys;
+		const double* zs;
+	};
+
+	class Drill
+	{
+	public:
+		Drill( const drill_record& record, const double* xs, const double* ys )
+			: record(record), xs(xs), ys(ys) {}
+
+		int tool() const { return record.tool; }
+		double diameter() const { return record.diameter; }
+		size_t hole_count() const { return record.hole_count; }
+		const double* x() const { return xs; }
+		const double* y() const { return ys; }
+
+	private:
+		const drill_record& record;
+		const double* xs;
+		const double* ys;
+	};
+
+	//! maps a toolpath file into memory
+	/*! The whole file is checked when opening it, which throws
+	 *  std::runtime_error if it isn't a readable toolpath file of this
+	 *  version; the accessors don't check anything after that. Everything
+	 *  they return points into the mapping and is valid while the Reader
+	 *  exists.
+	 */
+	class Reader
+	{
+	public:
+		explicit Reader( const std::string& filename ) : data(0), length(0)
+		{
+			if( !little_endian() )
+				throw std::runtime_error( "toolpath files can only be read on little-endian machines" );
+
+			int fd = open( filename.c_str(), O_RDONLY );
+			if( fd < 0 )
+				throw std::runtime_error( "can't open " + filename );
+
+			struct stat status;
+			if( fstat( fd, &status ) != 0 || status.st_size < off_t( sizeof(file_header) ) ) {
+				close( fd );
+				throw std::runtime_error( filename + " is not a toolpath file" );
+			}
+
+			length = status.st_size;
+			void* mapping = mmap( 0, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+			close( fd );
+			if( mapping == MAP_FAILED )
+				throw std::runtime_error( "can't map " + filename );
+			data = static_cast<const char*>( mapping );
+
+			try {
+				validate();
+			} catch( std::runtime_error& e ) {
+				munmap( const_cast<char*>( data ), length );
+				throw std::runtime_error( filename + ": " + e.what() );
+			}
+		}
+
+		~Reader()
+		{
+			munmap( const_cast<char*>( data ), length );
+		}
+
+		const file_header& header() const { return *at<file_header>( 0 ); }
+
+		size_t layer_count() const { return header().layer_count; }
+		Layer layer( size_t i ) const
+		{
+			const layer_record& record = at<layer_record>( header().layers_offset )[i];
+			return Layer( record, at<contour_record>( record.contours_offset ),
+				      at<double>( record.x_offset ),
+				      at<double>( record.y_offset ),
+				      record.flags & LAYER_HAS_Z ? at<double>( record.z_offset ) : 0 );
+		}
+
+		size_t drill_count() const { return header().drill_count; }
+		Drill drill( size_t i ) const
+		{
+			const drill_record& record = at<drill_record>( header().drills_offset )[i];
+			return Drill( record, at<double>( record.x_offset ),
+				      at<double>( record.y_offset ) );
+		}
+
+	private:
+		Reader( const Reader& );
+		Reader& operator=( const Reader& );
+
+		template <typename T>
+		const T* at( uint64_t offset ) const
+		{
+			return reinterpret_cast<const T*>( data + offset );
+		}
+
+		//! throws unless count Ts at offset are inside the file and aligned
+		template <typename T>
+		void check( uint64_t offset, uint64_t count ) const
+		{
+			if( offset % 8 != 0 || offset > length || count > ( length - offset ) / sizeof(T) )
+				throw std::runtime_error( "damaged toolpath file" );
+		}
+
+		void validate() const
+		{
+			const file_header& h = header();
+			if( std::memcmp( h.magic, magic, sizeof(magic) ) != 0 )
+				throw std::runtime_error( "not a toolpath file" );
+			if( h.version != version )
+				throw std::runtime_error( "unsupported toolpath file version" );
+
+			check<layer_record>( h.layers_offset, h.layer_count );
+			for( size_t i = 0; i < h.layer_count; i++ ) {
+				const layer_record& record = at<layer_record>( h.layers_offset )[i];
+				check<contour_record>( record.contours_offset, record.contour_count );
+				check<double>( record.x_offset, record.point_count );
+				check<double>( record.y_offset, record.point_count );
+				if( record.flags & LAYER_HAS_Z )
+					check<double>( record.z_offset, record.point_count );
+
+				const contour_record* contours = at<contour_record>( record.contours_offset );
+				for( size_t c = 0; c < record.contour_count; c++ ) {
+					if( contours[c].begin > record.point_count ||
+					    contours[c].size > record.point_count - contours[c].begin )
+						throw std::runtime_error( "damaged toolpath file" );
+				}
+			}
+
+			check<drill_record>( h.drills_offset, h.drill_count );
+			for( size_t i = 0; i < h.drill_count; i++ ) {
+				const drill_record& record = at<drill_record>( h.drills_offset )[i];
+				check<double>( record.x_offset, record.hole_count );
+				check<double>( record.y_offset, record.hole_count );
+			}
+		}
+
+		const char* data;
+		size_t length;
+	};
+}
+
+#endif // TOOLPATH_FILE_H